@@ -0,0 +1,88 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+// 8: arena blocks also hold u64 fields (descriptor title ids)
+#define ARENA_ALIGN(x) (((x) + 7) & ~((size_t) 7))
+#define ARENA_HEADER_SIZE ARENA_ALIGN(sizeof(arena_block_s))
+
+void arenaInit(arena_s *arena, size_t blockSize) {
+    arena->head = NULL;
+    arena->blockSize = blockSize > 0 ? blockSize : ARENA_BLOCK_SIZE;
+    arena->used = 0;
+    arena->highWater = 0;
+}
+
+void *arenaAlloc(arena_s *arena, size_t size) {
+
+    size = ARENA_ALIGN(size);
+
+    arena_block_s *block = arena->head;
+    if (block == NULL || block->used + size > block->size) {
+        // oversized allocations get a block of their own
+        size_t blockSize = size > arena->blockSize ? size : arena->blockSize;
+        block = malloc(ARENA_HEADER_SIZE + blockSize);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->size = blockSize;
+        block->used = 0;
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    void *ptr = (u8 *) block + ARENA_HEADER_SIZE + block->used;
+    block->used += size;
+    arena->used += size;
+    if (arena->used > arena->highWater) {
+        arena->highWater = arena->used;
+    }
+    return ptr;
+}
+
+char *arenaStrndup(arena_s *arena, const char *str, size_t len) {
+    char *dst = arenaAlloc(arena, len + 1);
+    if (dst) {
+        memcpy(dst, str, len);
+        dst[len] = '\0';
+    }
+    return dst;
+}
+
+char *arenaStrdup(arena_s *arena, const char *str) {
+    return arenaStrndup(arena, str, strlen(str));
+}
+
+void arenaFree(arena_s *arena) {
+    arena_block_s *block = arena->head;
+    while (block) {
+        arena_block_s *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->used = 0;
+}
+
+void arenaReset(arena_s *arena) {
+    arena_block_s *block = arena->head;
+    arena->head = NULL;
+    while (block) {
+        arena_block_s *next = block->next;
+        // the oldest block is the last one of the list
+        if (next == NULL && block->size == arena->blockSize) {
+            block->used = 0;
+            arena->head = block;
+        } else {
+            free(block);
+        }
+        block = next;
+    }
+    arena->used = 0;
+}
+
+size_t arenaHighWater(const arena_s *arena) {
+    return arena->highWater;
+}
@@ -0,0 +1,44 @@
+#ifndef _arena_h_
+#define _arena_h_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ARENA_BLOCK_SIZE 0x1000
+
+typedef struct arena_block_s {
+    struct arena_block_s *next;
+    size_t size;
+    size_t used;
+} arena_block_s;
+
+// bump allocator: allocations are never freed one by one,
+// the whole arena is released at once with arenaFree, or reused with arenaReset
+typedef struct {
+    arena_block_s *head;
+    size_t blockSize;
+    size_t used;        // bytes handed out since the last reset
+    size_t highWater;   // most bytes handed out between two resets
+} arena_s;
+
+void arenaInit(arena_s *arena, size_t blockSize);
+
+void *arenaAlloc(arena_s *arena, size_t size);
+
+char *arenaStrdup(arena_s *arena, const char *str);
+
+char *arenaStrndup(arena_s *arena, const char *str, size_t len);
+
+void arenaFree(arena_s *arena);
+
+// forget every allocation but keep the first block for the next ones,
+// blocks added past it (or oversized) are released
+void arenaReset(arena_s *arena);
+
+size_t arenaHighWater(const arena_s *arena);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _arena_h_
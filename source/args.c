@@ -0,0 +1,44 @@
+#include <3ds.h>
+#include <string.h>
+
+#include "args.h"
+
+void argsInit(args_s *args, u32 *buf, size_t size) {
+    args->buf = buf;
+    args->pos = (char *) (buf + 1);
+    args->end = (char *) buf + size;
+    args->overflow = false;
+    buf[0] = 0;
+}
+
+bool argsAdd(args_s *args, const char *str, size_t len) {
+
+    if (args->overflow || len >= (size_t) (args->end - args->pos)) {
+        args->overflow = true;
+        return false;
+    }
+
+    memcpy(args->pos, str, len);
+    args->pos[len] = '\0';
+    args->pos += len + 1;
+    args->buf[0]++;
+    return true;
+}
+
+bool argsAddList(args_s *args, const char *list, size_t len) {
+
+    const char *p = list, *end = list + len;
+    while (p < end) {
+        const char *next = memchr(p, '\0', (size_t) (end - p));
+        size_t n = next ? (size_t) (next - p) : (size_t) (end - p);
+        if (!argsAdd(args, p, n)) {
+            return false;
+        }
+        p += n + 1;
+    }
+    return true;
+}
+
+size_t argsLength(const args_s *args) {
+    return (size_t) (args->pos - (char *) args->buf);
+}
@@ -0,0 +1,33 @@
+#ifndef _args_h_
+#define _args_h_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// argument buffer handed to the 3dsx bootloader: u32 argc,
+// then the arguments, each one followed by a '\0'
+typedef struct {
+    u32 *buf;
+    char *pos;
+    char *end;
+    bool overflow;  // an argument didn't fit, it and the next ones were dropped
+} args_s;
+
+// size includes argc
+void argsInit(args_s *args, u32 *buf, size_t size);
+
+// append str[0..len), str doesn't need a terminator
+bool argsAdd(args_s *args, const char *str, size_t len);
+
+// append a list of '\0' separated arguments (3dslink command line, boot entry args),
+// the last one may be unterminated
+bool argsAddList(args_s *args, const char *list, size_t len);
+
+// bytes used in the buffer, argc included
+size_t argsLength(const args_s *args);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _args_h_
@@ -5,31 +5,152 @@
 
 #include <libconfig.h>
 #include "config.h"
+#include "config_cache.h"
+#include "config_journal.h"
+#include "config_keys.h"
+#include "config_schema.h"
+#include "payload.h"
+#include "trace.h"
 #include "utility.h"
 #include "font.h"
 
 #define CONFIG_PATH "/boot.cfg"
+#define CONFIG_TMP_PATH "/boot.cfg.tmp"
+#define CONFIG_BAK_PATH "/boot.cfg.bak"
+#define CONFIG_INTERN_WINDOW 16
+boot_config_s *config = NULL;
+boot_config_s *profiles = NULL;
+int profileCount = 0;
 config_t cfg;
 config_setting_t *setting_root = NULL, *setting_boot = NULL, *setting_entries = NULL;
+static bool cfg_loaded = false;
 
 int configCreate();
 
-void configThemeInit();
+int configLoadTree();
 
-void setColor(u8 *cfgColor, const char *color);
+int configParse();
+
+void configParseProfile(boot_config_s *cfg, config_setting_t *group);
+
+void configRecover();
+
+void configCommit();
+
+int configSyncTree();
+
+u32 configParseKeys(config_setting_t *setting);
+
+void configParseArgs(boot_config_s *cfg, boot_entry_s *entry, config_setting_t *setting);
 
 int configInit() {
 
-    config = malloc(sizeof(boot_config_s));
-    memset(config, 0, sizeof(boot_config_s));
+    configRecover();
+
+    // use the binary snapshot when it's still fresh, skipping libconfig entirely
+    if (configCacheLoad(CONFIG_PATH) != 0) {
+        configExit();
+        if (configParse() != 0) {
+            // keep a default profile around for the recovery menu
+            if (!profiles) {
+                configAllocProfiles(1);
+            }
+            return -1;
+        }
+        configCacheWrite(CONFIG_PATH);
+    }
+
+    // changes made since boot.cfg was last written
+    configJournalReplay(CONFIG_PATH);
+
+    // prevent invalid boot index and settings
+    int i;
+    for (i = 0; i < profileCount; i++) {
+        configSchemaClamp(&profiles[i]);
+    }
+
+    configBuildKeymaps();
+
+    return 0;
+}
+
+// allocate the profile table, every profile starts with the defaults
+boot_config_s *configAllocProfiles(int count) {
+
+    profiles = malloc(count * sizeof(boot_config_s));
+    if (!profiles) {
+        return NULL;
+    }
+    memset(profiles, 0, count * sizeof(boot_config_s));
+    profileCount = count;
+
+    int i;
+    for (i = 0; i < count; i++) {
+        boot_config_s *cfg = &profiles[i];
+        arenaInit(&cfg->strings, ARENA_BLOCK_SIZE);
+        cfg->name = "default";
+        cfg->profileKeys = 0;
+        keymapInit(&cfg->keymap);
+        configSchemaDefaults(cfg);
+    }
+
+    config = &profiles[0];
+    return profiles;
+}
+
+// switching profile is only a pointer swap, everything is resolved at load time
+void configSelectProfile(int index) {
+    if (index >= 0 && index < profileCount) {
+        config = &profiles[index];
+    }
+}
+
+// finish (or roll back) a configWrite interrupted by a power loss
+void configRecover() {
+
+    FILE *file = fopen(CONFIG_PATH, "rb");
+    if (file != NULL) {
+        fclose(file);
+        remove(CONFIG_TMP_PATH);
+        remove(CONFIG_BAK_PATH);
+        return;
+    }
+
+    // the temp file is complete once boot.cfg was moved away
+    if (rename(CONFIG_TMP_PATH, CONFIG_PATH) == 0
+        || rename(CONFIG_BAK_PATH, CONFIG_PATH) == 0) {
+        remove(CONFIG_BAK_PATH);
+    }
+}
+
+// theme resources are only needed once the menu is drawn,
+// the autoboot path never gets here
+void configInitTheme() {
 
-    config->timeout = 3;
-    config->autobootfix = 100;
-    config->index = 0;
-    config->recovery = 2;
-    configThemeInit();
+    static boot_config_s *applied = NULL;
+    if (applied == config) {
+        return;
+    }
+
+    memcpy(fontDefault.color, config->fntDef, sizeof(u8[3]));
+    memcpy(fontSelected.color, config->fntSel, sizeof(u8[3]));
+    if (!config->themeLoaded) {
+        loadImages();
+        config->themeLoaded = true;
+        traceMark(TRACE_THEME);
+    }
+    applied = config;
+}
+
+// load the libconfig tree, only needed when parsing or writing boot.cfg
+int configLoadTree() {
+
+    if (cfg_loaded) {
+        return 0;
+    }
 
     config_init(&cfg);
+    cfg_loaded = true;
 
     if (!config_read_file(&cfg, CONFIG_PATH)) {
         debug("Configuration file not found: %s\nCreating default configuration..\n", CONFIG_PATH);
@@ -40,111 +161,163 @@ int configInit() {
     }
 
     setting_boot = config_lookup(&cfg, "boot_config");
+    setting_entries = config_lookup(&cfg, "boot_config.entries");
+
+    return 0;
+}
+
+int configParse() {
+
+    if (configLoadTree() != 0) {
+        return -1;
+    }
+
+    config_setting_t *setting_profiles = NULL;
     if (setting_boot != NULL) {
-        int timeout = 3, autobootfix = 8, index = 0, recovery = 2; //SELECT
+        setting_profiles = config_setting_lookup(setting_boot, "profiles");
+    }
+    int count = setting_profiles ? config_setting_length(setting_profiles) : 0;
 
-        if (config_setting_lookup_int(setting_boot, "timeout", &timeout)) {
-            config->timeout = timeout;
-        }
-        if (config_setting_lookup_int(setting_boot, "autobootfix", &autobootfix)) {
-            config->autobootfix = autobootfix;
-        }
-        if (config_setting_lookup_int(setting_boot, "default", &index)) {
-            config->index = index;
-        }
-        if (config_setting_lookup_int(setting_boot, "recovery", &recovery)) {
-            config->recovery = recovery;
+    if (!configAllocProfiles(count + 1)) {
+        return -1;
+    }
+
+    if (setting_boot != NULL) {
+        configParseProfile(&profiles[0], setting_boot);
+    }
+
+    int i;
+    for (i = 0; i < count; i++) {
+        boot_config_s *cfg = &profiles[i + 1];
+        config_setting_t *group = config_setting_get_elem(setting_profiles, (unsigned int) i);
+        const char *name;
+
+        // inherit the main profile settings and theme
+        configSchemaInherit(cfg, &profiles[0]);
+
+        if (config_setting_lookup_string(group, "name", &name)) {
+            cfg->name = arenaStrdup(&cfg->strings, name);
         }
+        cfg->profileKeys = configParseKeys(config_setting_lookup(group, "key"));
+        configParseProfile(cfg, group);
     }
 
-    setting_entries = config_lookup(&cfg, "boot_config.entries");
-    if (setting_entries != NULL) {
-        int count = config_setting_length(setting_entries);
-        if (count > CONFIG_MAX_ENTRIES)
-            count = CONFIG_MAX_ENTRIES;
+    // shared settings only come from boot_config
+    configSchemaShare(&profiles[0]);
+
+    return 0;
+}
+
+// read a boot_config group, or a profile group of boot_config.profiles
+void configParseProfile(boot_config_s *cfg, config_setting_t *group) {
+
+    // settings and theme, see config_schema.h
+    configSchemaRead(cfg, group);
+
+    config_setting_t *setting_list = config_setting_lookup(group, "entries");
+    if (setting_list != NULL) {
+        int count = config_setting_length(setting_list);
 
         int i;
         for (i = 0; i < count; ++i) {
-            config_setting_t *entry = config_setting_get_elem(setting_entries, (unsigned int) i);
-            const char *title, *path, *offset;
-            int key = -1;
+            config_setting_t *entry = config_setting_get_elem(setting_list, (unsigned int) i);
+            const char *title, *path, *offset, *crc, *str;
 
             if (!(config_setting_lookup_string(entry, "title", &title)
                   && config_setting_lookup_string(entry, "path", &path)))
                 continue;
 
-            strncpy(config->entries[i].title, title, 512);
-            strncpy(config->entries[i].path, path, 512);
-            config->entries[i].key = -1;
-            if (config_setting_lookup_int(entry, "key", &key)) {
-                config->entries[i].key = key;
+            boot_entry_s *e = configNewEntry(cfg, title, path);
+            if (!e) {
+                break;
             }
+            e->keys = configParseKeys(config_setting_lookup(entry, "key"));
             if (config_setting_lookup_string(entry, "offset", &offset)) {
-                config->entries[i].offset = strtoul(offset, NULL, 16);
+                e->offset = strtoul(offset, NULL, 16);
             }
-            config->count++;
-        }
-        // prevent invalid boot index
-        if (config->index >= config->count || config->index < 0) {
-            config->index = 0;
+            // optional integrity check
+            int size;
+            if (config_setting_lookup_int(entry, "size", &size) && size > 0) {
+                e->size = (u32) size;
+            }
+            if (config_setting_lookup_string(entry, "crc32", &crc)) {
+                e->crc = strtoul(crc, NULL, 16);
+                e->hasCrc = true;
+            }
+            // optional payload pipeline stages
+            if (config_setting_lookup_string(entry, "compression", &str)
+                && (strcasecmp(str, "zlib") == 0 || strcasecmp(str, "gzip") == 0)) {
+                e->payload |= PAYLOAD_ZLIB;
+            }
+            if (config_setting_lookup_string(entry, "patch", &str) && *str) {
+                e->patch = configIntern(cfg, str);
+            }
+            configParseArgs(cfg, e, config_setting_lookup(entry, "args"));
         }
     }
+}
 
-    // "theme"
-    config_setting_t *setting_theme = config_lookup(&cfg, "boot_config.theme");
-    if (setting_theme != NULL) {
+static const char *configArg(config_setting_t *setting, int index) {
+    return config_setting_is_aggregate(setting)
+           ? config_setting_get_string_elem(setting, index) : config_setting_get_string(setting);
+}
 
-        const char *str, *path;
-        if (config_setting_lookup_string(setting_theme, "bgTop1", &str)) {
-            setColor(config->bgTop1, str);
-        }
-        if (config_setting_lookup_string(setting_theme, "bgTop2", &str)) {
-            setColor(config->bgTop2, str);
-        }
-        if (config_setting_lookup_string(setting_theme, "bgBottom", &str)) {
-            setColor(config->bgBot, str);
-        }
-        if (config_setting_lookup_string(setting_theme, "highlight", &str)) {
-            setColor(config->highlight, str);
-        }
-        if (config_setting_lookup_string(setting_theme, "borders", &str)) {
-            setColor(config->borders, str);
-        }
-        if (config_setting_lookup_string(setting_theme, "font1", &str)) {
-            setColor(config->fntDef, str);
-        }
-        if (config_setting_lookup_string(setting_theme, "font2", &str)) {
-            setColor(config->fntSel, str);
-        }
-        if (config_setting_lookup_string(setting_theme, "bgImgTop", &path)) {
-            strncpy(config->bgImgTop, path, 512);
-        }
-        if (config_setting_lookup_string(setting_theme, "bgImgBot", &path)) {
-            strncpy(config->bgImgBot, path, 512);
-        }
+// "args = "-v";" or "args = ["-v", "file"];", stored '\0' separated
+void configParseArgs(boot_config_s *cfg, boot_entry_s *entry, config_setting_t *setting) {
+
+    if (!setting) {
+        return;
     }
-    memcpy(fontDefault.color, config->fntDef, sizeof(u8[3]));
-    memcpy(fontSelected.color, config->fntSel, sizeof(u8[3]));
-    loadImages();
 
-    return 0;
-}
+    int count = config_setting_is_aggregate(setting) ? config_setting_length(setting) : 1;
+    size_t len = 0;
+    int i;
+    for (i = 0; i < count; i++) {
+        const char *arg = configArg(setting, i);
+        len += arg ? strlen(arg) + 1 : 0;
+    }
+    if (len == 0 || len > 0xFFFF) {
+        return;
+    }
 
-void setColor(u8 *cfgColor, const char *color) {
-    long l = strtoul(color, NULL, 16);
-    cfgColor[0] = (u8) (l >> 16 & 0xFF);
-    cfgColor[1] = (u8) (l >> 8 & 0xFF);
-    cfgColor[2] = (u8) (l & 0xFF);
+    char *args = arenaAlloc(&cfg->strings, len);
+    if (!args) {
+        return;
+    }
+    char *dst = args;
+    for (i = 0; i < count; i++) {
+        const char *arg = configArg(setting, i);
+        if (arg) {
+            size_t n = strlen(arg) + 1;
+            memcpy(dst, arg, n);
+            dst += n;
+        }
+    }
+    entry->args = args;
+    entry->argsLen = (u16) len;
 }
 
-void configThemeInit() {
-    memcpy(config->bgTop1, (u8[3]) {0x4a, 0x00, 0x31}, sizeof(u8[3]));
-    memcpy(config->bgTop2, (u8[3]) {0x6f, 0x01, 0x49}, sizeof(u8[3]));
-    memcpy(config->bgBot, (u8[3]) {0x6f, 0x01, 0x49}, sizeof(u8[3]));
-    memcpy(config->highlight, (u8[3]) {0xdc, 0xdc, 0xdc}, sizeof(u8[3]));
-    memcpy(config->borders, (u8[3]) {0xff, 0xff, 0xff}, sizeof(u8[3]));
-    memcpy(config->fntDef, (u8[3]) {0xff, 0xff, 0xff}, sizeof(u8[3]));
-    memcpy(config->fntSel, (u8[3]) {0x00, 0x00, 0x00}, sizeof(u8[3]));
+// "key = 0;" for a single button, "key = [9, 0];" for a chord (L+A)
+u32 configParseKeys(config_setting_t *setting) {
+
+    if (!setting) {
+        return 0;
+    }
+
+    if (config_setting_type(setting) == CONFIG_TYPE_INT) {
+        int key = config_setting_get_int(setting);
+        return key >= 0 && key < 32 ? BIT(key) : 0;
+    }
+
+    u32 keys = 0;
+    int i, count = config_setting_is_aggregate(setting) ? config_setting_length(setting) : 0;
+    for (i = 0; i < count; i++) {
+        int key = config_setting_get_int_elem(setting, i);
+        if (key >= 0 && key < 32) {
+            keys |= BIT(key);
+        }
+    }
+    return keys;
 }
 
 int configCreate() {
@@ -154,24 +327,18 @@ int configCreate() {
     // create main group
     setting_boot = config_setting_add(setting_root, "boot_config", CONFIG_TYPE_GROUP);
 
-    // create timeout setting
-    config_setting_t *setting = config_setting_add(setting_boot, "timeout", CONFIG_TYPE_INT);
-    config_setting_set_int(setting, 3);
-
-    // create autobootfix setting
-    setting = config_setting_add(setting_boot, "autobootfix", CONFIG_TYPE_INT);
-    config_setting_set_int(setting, 8);
-
-    // create recovery setting
-    setting = config_setting_add(setting_boot, "recovery", CONFIG_TYPE_INT);
-    config_setting_set_int(setting, 2);
-
-    // create default setting
-    setting = config_setting_add(setting_boot, "default", CONFIG_TYPE_INT);
-    config_setting_set_int(setting, 0);
+    // create the settings with their defaults
+    int i;
+    for (i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_schema_s *s = &config_schema[i];
+        if (configSchemaIsInt(s) && !(s->flags & (CONFIG_SCHEMA_THEME | CONFIG_SCHEMA_MAIN))) {
+            config_setting_t *setting = config_setting_add(setting_boot, s->name, CONFIG_TYPE_INT);
+            config_setting_set_int(setting, s->def);
+        }
+    }
 
-    // create entries group setting
-    setting_entries = config_setting_add(setting_boot, "entries", CONFIG_TYPE_GROUP);
+    // create entries list setting
+    setting_entries = config_setting_add(setting_boot, "entries", CONFIG_TYPE_LIST);
 
     if (!config_write_file(&cfg, CONFIG_PATH)) {
         return -1;
@@ -179,122 +346,302 @@ int configCreate() {
     return 0;
 }
 
-int configAddEntry(char *title, char *path, long offset) {
+// return an already stored copy of str if any, so duplicated
+// titles/paths are only stored once in the arena, only the last
+// entries are searched so loading a long list stays linear
+const char *configIntern(boot_config_s *cfg, const char *str) {
+    int i;
+    for (i = cfg->count > CONFIG_INTERN_WINDOW ? cfg->count - CONFIG_INTERN_WINDOW : 0; i < cfg->count; i++) {
+        if (strcmp(cfg->entries[i].path, str) == 0) {
+            return cfg->entries[i].path;
+        }
+        if (strcmp(cfg->entries[i].title, str) == 0) {
+            return cfg->entries[i].title;
+        }
+    }
+    return arenaStrdup(&cfg->strings, str);
+}
 
-    if (!setting_entries) {
-        debug("Couldn't add entry: entries section not found\n");
-        return -1;
+// append an entry to the table, growing it as needed
+boot_entry_s *configNewEntry(boot_config_s *cfg, const char *title, const char *path) {
+
+    if (cfg->count >= cfg->capacity) {
+        int capacity = cfg->capacity > 0 ? cfg->capacity * 2 : 8;
+        boot_entry_s *entries = realloc(cfg->entries, capacity * sizeof(boot_entry_s));
+        if (!entries) {
+            return NULL;
+        }
+        cfg->entries = entries;
+        cfg->capacity = capacity;
     }
 
-    config_setting_t *entry, *setting;
-    // add group (entry)
-    entry = config_setting_add(setting_entries, NULL, CONFIG_TYPE_GROUP);
-    // add title
-    setting = config_setting_add(entry, "title", CONFIG_TYPE_STRING);
-    config_setting_set_string(setting, title);
-    // add path
-    setting = config_setting_add(entry, "path", CONFIG_TYPE_STRING);
-    config_setting_set_string(setting, path);
-    // add key
-    setting = config_setting_add(entry, "key", CONFIG_TYPE_INT);
-    config_setting_set_int(setting, -1);
-    // add offset
-    if (offset > 0) {
+    boot_entry_s *entry = &cfg->entries[cfg->count];
+    entry->title = configIntern(cfg, title);
+    entry->path = configIntern(cfg, path);
+    entry->keys = 0;
+    entry->keyConflict = false;
+    entry->offset = 0;
+    entry->size = 0;
+    entry->crc = 0;
+    entry->hasCrc = false;
+    entry->verify = VERIFY_NONE;
+    entry->payload = 0;
+    entry->patch = NULL;
+    entry->args = NULL;
+    entry->argsLen = 0;
+    if (!entry->title || !entry->path) {
+        return NULL;
     }
 
-    // write/update config file
-    configWrite();
+    cfg->count++;
+    return entry;
+}
+
+int configAddEntry(const char *title, const char *path, long offset) {
+
+    boot_entry_s *entry = configNewEntry(config, title, path);
+    if (!entry) {
+        debug("Couldn't add entry: out of memory\n");
+        return -1;
+    }
+    entry->offset = offset;
+    configBuildKeymaps();
 
-    strncpy(config->entries[config->count].title, title, 512);
-    strncpy(config->entries[config->count].path, path, 512);
-    config->entries[config->count].key = -1;
-    config->count++;
+    if (configJournalAdd(config - profiles, entry) != 0) {
+        // journal unusable, write the whole file instead
+        return configWrite();
+    }
+    configCommit();
 
     return 0;
 }
 
-int configRemoveEntry(int index) {
+// remove an entry from the in-memory table only
+int configDeleteEntry(boot_config_s *cfg, int index) {
 
-    // remove element
-    if (!config_setting_remove_elem(setting_entries, (unsigned int) index)) {
+    if (index < 0 || index >= cfg->count) {
         return -1;
     }
 
+    memmove(&cfg->entries[index], &cfg->entries[index + 1],
+            (cfg->count - index - 1) * sizeof(boot_entry_s));
+    cfg->count--;
+
     // update default boot index
-    if (config->index >= index) {
-        config->index--;
-        config_setting_t *s = config_setting_lookup(setting_boot, "default");
-        if (s) {
-            config_setting_set_int(s, config->index);
-        }
+    if (cfg->index >= index && cfg->index > 0) {
+        cfg->index--;
     }
 
-    // write/update config file
-    configWrite();
+    return 0;
+}
+
+int configRemoveEntry(int index) {
 
-    // reload config
-    configExit();
-    configInit();
+    if (configDeleteEntry(config, index) != 0) {
+        return -1;
+    }
+    configBuildKeymaps();
+
+    if (configJournalRemove(config - profiles, index) != 0) {
+        return configWrite();
+    }
+    configCommit();
 
     return 0;
 }
 
 void configUpdateSettings() {
 
-    if (setting_boot) {
+    // bootfix and recovery key are shared by all profiles
+    configSchemaShare(config);
+    configBuildKeymaps();
 
-        config_setting_t *s = config_setting_lookup(setting_boot, "timeout");
-        if (s) {
-            config_setting_set_int(s, config->timeout);
-        } else {
-            debug("Error: timeout setting not found\n");
-        }
+    if (configJournalSettings(config - profiles) != 0) {
+        configWrite();
+        return;
+    }
+    configCommit();
+}
 
-        s = config_setting_lookup(setting_boot, "autobootfix");
-        if (s) {
-            config_setting_set_int(s, config->autobootfix);
+// write boot.cfg only once enough changes are pending in the journal
+void configCommit() {
+    if (configJournalCount() >= CONFIG_JOURNAL_MAX) {
+        configWrite();
+    }
+}
+
+// inverse of configParseKeys
+static void configSetKeys(config_setting_t *parent, u32 keys) {
+
+    if (!keys) {
+        return;
+    }
+
+    if (!(keys & (keys - 1))) {
+        config_setting_t *s = config_setting_add(parent, "key", CONFIG_TYPE_INT);
+        config_setting_set_int(s, __builtin_ctz(keys));
+        return;
+    }
+
+    config_setting_t *s = config_setting_add(parent, "key", CONFIG_TYPE_ARRAY);
+    while (keys) {
+        config_setting_set_int_elem(s, -1, __builtin_ctz(keys));
+        keys &= keys - 1;
+    }
+}
+
+static void configSyncEntries(boot_config_s *cfg, config_setting_t *group) {
+
+    if (config_setting_lookup(group, "entries")) {
+        config_setting_remove(group, "entries");
+    }
+    config_setting_t *setting_list = config_setting_add(group, "entries", CONFIG_TYPE_LIST);
+    if (!setting_list) {
+        return;
+    }
+
+    int i;
+    for (i = 0; i < cfg->count; i++) {
+        config_setting_t *entry, *setting;
+        // add group (entry)
+        entry = config_setting_add(setting_list, NULL, CONFIG_TYPE_GROUP);
+        // add title
+        setting = config_setting_add(entry, "title", CONFIG_TYPE_STRING);
+        config_setting_set_string(setting, cfg->entries[i].title);
+        // add path
+        setting = config_setting_add(entry, "path", CONFIG_TYPE_STRING);
+        config_setting_set_string(setting, cfg->entries[i].path);
+        // add key
+        configSetKeys(entry, cfg->entries[i].keys);
+        // add offset
+        if (cfg->entries[i].offset > 0) {
+            char offset[20];
+            snprintf(offset, sizeof(offset), "0x%lx", cfg->entries[i].offset);
+            setting = config_setting_add(entry, "offset", CONFIG_TYPE_STRING);
+            config_setting_set_string(setting, offset);
         }
-        else {
-            debug("Error: autobootfix setting not found\n");
+        // add size and crc32
+        if (cfg->entries[i].size > 0) {
+            setting = config_setting_add(entry, "size", CONFIG_TYPE_INT);
+            config_setting_set_int(setting, (int) cfg->entries[i].size);
         }
-
-        s = config_setting_lookup(setting_boot, "default");
-        if (s) {
-            config_setting_set_int(s, config->index);
+        if (cfg->entries[i].hasCrc) {
+            char crc[16];
+            snprintf(crc, 16, "0x%08lx", (unsigned long) cfg->entries[i].crc);
+            setting = config_setting_add(entry, "crc32", CONFIG_TYPE_STRING);
+            config_setting_set_string(setting, crc);
         }
-        else {
-            debug("Error: default setting not found\n");
+        // add payload stages
+        if (cfg->entries[i].payload & PAYLOAD_ZLIB) {
+            setting = config_setting_add(entry, "compression", CONFIG_TYPE_STRING);
+            config_setting_set_string(setting, "zlib");
         }
-
-        s = config_setting_lookup(setting_boot, "recovery");
-        if (s) {
-            config_setting_set_int(s, config->recovery);
+        if (cfg->entries[i].patch) {
+            setting = config_setting_add(entry, "patch", CONFIG_TYPE_STRING);
+            config_setting_set_string(setting, cfg->entries[i].patch);
         }
-        else {
-            debug("Error: recovery setting not found\n");
+        // add 3dsx arguments
+        if (cfg->entries[i].args) {
+            setting = config_setting_add(entry, "args", CONFIG_TYPE_ARRAY);
+            const char *arg = cfg->entries[i].args;
+            while (arg < cfg->entries[i].args + cfg->entries[i].argsLen) {
+                config_setting_set_string(config_setting_add(setting, NULL, CONFIG_TYPE_STRING), arg);
+                arg += strlen(arg) + 1;
+            }
         }
+    }
+}
 
-        configWrite();
+// make the libconfig tree match the in-memory config
+int configSyncTree() {
+
+    if (configLoadTree() != 0) {
+        return -1;
+    }
+    if (!setting_boot) {
+        setting_boot = config_setting_add(config_root_setting(&cfg), "boot_config", CONFIG_TYPE_GROUP);
+        if (!setting_boot) {
+            return -1;
+        }
     }
+
+    configSchemaWrite(&profiles[0], setting_boot, true);
+    configSyncEntries(&profiles[0], setting_boot);
+    setting_entries = config_setting_lookup(setting_boot, "entries");
+
+    config_setting_t *setting_profiles = config_setting_lookup(setting_boot, "profiles");
+    int i;
+    for (i = 1; i < profileCount && setting_profiles; i++) {
+        config_setting_t *group = config_setting_get_elem(setting_profiles, (unsigned int) i - 1);
+        if (!group) {
+            break;
+        }
+        configSchemaWrite(&profiles[i], group, false);
+        configSyncEntries(&profiles[i], group);
+    }
+
+    return 0;
 }
 
-void configWrite() {
-    if (!config_write_file(&cfg, "/boot.cfg")) {
-        debug("Error while writing config file:\n.%s\n", "/boot.cfg");
+// compact the in-memory config into a fresh boot.cfg:
+// write it to a temp file, then swap it in, so a power loss
+// at any point leaves either the old or the new file (see configRecover)
+int configWrite() {
+
+    profiles[0].generation++;
+    if (configSyncTree() != 0) {
+        profiles[0].generation--;
+        debug("Error while writing config file:\n.%s\n", CONFIG_PATH);
+        return -1;
+    }
+
+    if (!config_write_file(&cfg, CONFIG_TMP_PATH)) {
+        profiles[0].generation--;
+        remove(CONFIG_TMP_PATH);
+        debug("Error while writing config file:\n.%s\n", CONFIG_TMP_PATH);
+        return -1;
     }
+
+    configCacheInvalidate();
+    remove(CONFIG_BAK_PATH);
+    if (rename(CONFIG_PATH, CONFIG_BAK_PATH) != 0
+        || rename(CONFIG_TMP_PATH, CONFIG_PATH) != 0) {
+        configRecover();
+        profiles[0].generation--;
+        debug("Error while writing config file:\n.%s\n", CONFIG_PATH);
+        return -1;
+    }
+    remove(CONFIG_BAK_PATH);
+
+    // the new generation makes any leftover journal stale
+    configJournalClear();
+    configCacheWrite(CONFIG_PATH);
+
+    return 0;
 }
 
 void configExit() {
-    if (config) {
-        if (config->bgImgTopBuff) {
-            free(config->bgImgTopBuff);
+    configFreeKeymaps();
+    int i;
+    for (i = 0; i < profileCount; i++) {
+        boot_config_s *cfg = &profiles[i];
+        if (cfg->bgImgTopBuff) {
+            free(cfg->bgImgTopBuff);
         }
-        if (config->bgImgBotBuff) {
-            free(config->bgImgBotBuff);
+        if (cfg->bgImgBotBuff) {
+            free(cfg->bgImgBotBuff);
         }
+        free(cfg->entries);
+        arenaFree(&cfg->strings);
+    }
+    if (cfg_loaded) {
         config_destroy(&cfg);
-        free(config);
+        cfg_loaded = false;
     }
+    free(profiles);
+    profiles = NULL;
+    profileCount = 0;
+    config = NULL;
 }
 
 void loadImages() {
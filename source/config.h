@@ -5,23 +5,67 @@
 extern "C" {
 #endif
 
+#include "arena.h"
+
 #define BIT(n) (1U<<(n))
-#define CONFIG_MAX_ENTRIES 11
 
+// payload check against the size/crc32 given in boot.cfg (see verify.c)
+enum {
+    VERIFY_NONE = 0,
+    VERIFY_PENDING,
+    VERIFY_OK,
+    VERIFY_MISSING,
+    VERIFY_BAD_SIZE,
+    VERIFY_BAD_CRC
+};
+
+// title and path point into boot_config_s.strings
 typedef struct {
-    char title[512];
-    char path[512];
-    int key;
+    const char *title;
+    const char *path;
+    u32 keys;           // KEY_* mask to hold at power-on, several bits make a chord
+    bool keyConflict;   // keys already bound elsewhere, ignored
     long offset;
+    u32 size;           // expected payload size, 0 if unknown
+    u32 crc;            // expected crc32 of the payload, if hasCrc
+    bool hasCrc;
+    u8 verify;
+    u32 payload;        // PAYLOAD_* flags (see payload.h)
+    const char *patch;  // ips patch applied to the payload, NULL if none
+    const char *args;   // 3dsx arguments, each one followed by a '\0', NULL if none
+    u16 argsLen;
 } boot_entry_s;
 
 typedef struct {
+    u32 keys;
+    int target;
+} boot_binding_s;
+
+// keys -> entry (or profile) table, built once at load time:
+// a dense slot per button and the chords, longest first
+typedef struct {
+    s16 single[32];
+    boot_binding_s *chords;
+    int chordCount;
+    int chordCapacity;
+} boot_keymap_s;
+
+// one boot profile, the first one is the main "boot_config" group
+typedef struct {
+    const char *name;
+    u32 profileKeys;
+    bool profileKeyConflict;
     int timeout;
     int autobootfix;
     int index;
     int recovery;
+    int trace;
+    int generation;
     int count;
-    boot_entry_s entries[12];
+    int capacity;
+    boot_entry_s *entries;
+    boot_keymap_s keymap;
+    arena_s strings;
     u8 bgTop1[3];
     u8 bgTop2[3];
     u8 bgBot[3];
@@ -31,6 +75,7 @@ typedef struct {
     u8 fntSel[3];
     char bgImgTop[512];
     char bgImgBot[512];
+    bool themeLoaded;
     bool imgError;
     bool imgErrorBot;
     u8 *bgImgTopBuff;
@@ -39,20 +84,37 @@ typedef struct {
     off_t bgImgBotSize;
 } boot_config_s;
 
-boot_config_s *config;
+// active profile
+extern boot_config_s *config;
+
+// all profiles, resolved at load time
+extern boot_config_s *profiles;
+extern int profileCount;
 
 int configInit();
 
-int configAddEntry(char *title, char *path, long offset);
+boot_config_s *configAllocProfiles(int count);
+
+void configSelectProfile(int index);
+
+int configAddEntry(const char *title, const char *path, long offset);
+
+boot_entry_s *configNewEntry(boot_config_s *cfg, const char *title, const char *path);
+
+const char *configIntern(boot_config_s *cfg, const char *str);
 
 int configRemoveEntry(int index);
 
+int configDeleteEntry(boot_config_s *cfg, int index);
+
 void configUpdateSettings();
 
-void configWrite();
+int configWrite();
 
 void configExit();
 
+void configInitTheme();
+
 void loadImages();
 
 #ifdef __cplusplus
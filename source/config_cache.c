@@ -0,0 +1,431 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <zlib.h>
+#include "config_cache.h"
+#include "config_schema.h"
+
+// payload layout (little endian, packed):
+//  s32 profileCount
+//  profileCount * profile
+// profile:
+//  str name, u32 profileKeys, s32 count
+//  every config_schema setting in order: s32 for ints, u8[3] for colors, str for paths
+//  count * { u32 keys, u32 offset, u32 size, u32 crc, s32 hasCrc, u32 payload, str title, str path, str patch, str args }
+// where str is a u16 length followed by the characters (no terminator),
+// args keeps the '\0' between its arguments
+
+typedef struct {
+    u8 *buf;
+    size_t size;
+    size_t pos;
+    bool error;
+} cache_stream_s;
+
+static void cacheWrite(cache_stream_s *s, const void *data, size_t len) {
+    if (s->error || s->pos + len > s->size) {
+        s->error = true;
+        return;
+    }
+    memcpy(s->buf + s->pos, data, len);
+    s->pos += len;
+}
+
+static void cacheRead(cache_stream_s *s, void *data, size_t len) {
+    if (s->error || s->pos + len > s->size) {
+        s->error = true;
+        return;
+    }
+    memcpy(data, s->buf + s->pos, len);
+    s->pos += len;
+}
+
+static void cacheWriteInt(cache_stream_s *s, s32 v) {
+    cacheWrite(s, &v, sizeof(s32));
+}
+
+static s32 cacheReadInt(cache_stream_s *s) {
+    s32 v = 0;
+    cacheRead(s, &v, sizeof(s32));
+    return v;
+}
+
+static void cacheWriteStr(cache_stream_s *s, const char *str, size_t max) {
+    u16 len = (u16) strnlen(str, max - 1);
+    cacheWrite(s, &len, sizeof(u16));
+    cacheWrite(s, str, len);
+}
+
+static void cacheReadStr(cache_stream_s *s, char *str, size_t max) {
+    u16 len = 0;
+    cacheRead(s, &len, sizeof(u16));
+    if (len >= max) {
+        s->error = true;
+        return;
+    }
+    cacheRead(s, str, len);
+    if (!s->error) {
+        str[len] = '\0';
+    }
+}
+
+// strings are read in place, the caller copies them out
+static const char *cacheReadView(cache_stream_s *s, u16 *len) {
+    *len = 0;
+    cacheRead(s, len, sizeof(u16));
+    if (s->error || s->pos + *len > s->size) {
+        s->error = true;
+        return NULL;
+    }
+    const char *str = (const char *) s->buf + s->pos;
+    s->pos += *len;
+    return str;
+}
+
+static void cacheWriteData(cache_stream_s *s, const void *data, u16 len) {
+    cacheWrite(s, &len, sizeof(u16));
+    if (len > 0) {
+        cacheWrite(s, data, len);
+    }
+}
+
+static size_t cacheProfileSize(boot_config_s *cfg) {
+    size_t size = sizeof(u16) + strlen(cfg->name) + 2 * sizeof(s32);
+    int i;
+    for (i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_schema_s *setting = &config_schema[i];
+        switch (setting->type) {
+            case CONFIG_SCHEMA_COLOR:
+                size += sizeof(u8[3]);
+                break;
+            case CONFIG_SCHEMA_PATH:
+                size += sizeof(u16) + strnlen((const char *) configSchemaData(cfg, setting), setting->size - 1);
+                break;
+            default:
+                size += sizeof(s32);
+                break;
+        }
+    }
+    for (i = 0; i < cfg->count; i++) {
+        size += 6 * sizeof(s32) + 4 * sizeof(u16)
+                + strlen(cfg->entries[i].title) + strlen(cfg->entries[i].path)
+                + (cfg->entries[i].patch ? strlen(cfg->entries[i].patch) : 0)
+                + cfg->entries[i].argsLen;
+    }
+    return size;
+}
+
+int configCacheSourceInfo(const char *cfgPath, u32 *size, u32 *mtime) {
+    struct stat st;
+    if (stat(cfgPath, &st) != 0) {
+        return -1;
+    }
+    *size = (u32) st.st_size;
+    *mtime = (u32) st.st_mtime;
+    return 0;
+}
+
+u32 configCacheSourceCrc(const char *cfgPath, u32 size) {
+    u32 crc = (u32) crc32(0L, Z_NULL, 0);
+    FILE *file = fopen(cfgPath, "rb");
+    if (file == NULL) {
+        return crc;
+    }
+    u8 *buf = malloc(size);
+    if (buf) {
+        if (fread(buf, 1, size, file) == size) {
+            crc = (u32) crc32(crc, buf, size);
+        }
+        free(buf);
+    }
+    fclose(file);
+    return crc;
+}
+
+// size and mtime alone can't tell: no mtime on this fs, or boot.cfg was written
+// so close to the cache that a rewrite of the same size would keep its mtime
+static bool cacheAmbiguous(const config_cache_header_s *hdr) {
+    return hdr->cfgMtime == 0 || (s32) (hdr->writeTime - hdr->cfgMtime) < CONFIG_CACHE_MTIME_RESOLUTION;
+}
+
+// once boot.cfg is old enough, later boots can trust its mtime again
+static void cacheSettle(config_cache_header_s *hdr) {
+    u32 now = (u32) time(NULL);
+    if (hdr->cfgMtime == 0 || (s32) (now - hdr->cfgMtime) < CONFIG_CACHE_MTIME_RESOLUTION) {
+        return;
+    }
+    hdr->writeTime = now;
+    FILE *file = fopen(CONFIG_CACHE_PATH, "r+b");
+    if (file != NULL) {
+        fwrite(hdr, 1, sizeof(config_cache_header_s), file);
+        fclose(file);
+    }
+}
+
+static void cacheReadProfile(cache_stream_s *s, boot_config_s *cfg) {
+
+    u16 nameLen;
+    const char *name = cacheReadView(s, &nameLen);
+    if (s->error) {
+        return;
+    }
+    cfg->name = arenaStrndup(&cfg->strings, name, nameLen);
+    cfg->profileKeys = (u32) cacheReadInt(s);
+    int count = cacheReadInt(s);
+
+    int i;
+    for (i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_schema_s *setting = &config_schema[i];
+        switch (setting->type) {
+            case CONFIG_SCHEMA_COLOR:
+                cacheRead(s, configSchemaData(cfg, setting), sizeof(u8[3]));
+                break;
+            case CONFIG_SCHEMA_PATH:
+                cacheReadStr(s, (char *) configSchemaData(cfg, setting), setting->size);
+                break;
+            default:
+                *configSchemaInt(cfg, setting) = cacheReadInt(s);
+                break;
+        }
+    }
+
+    if (count < 0) {
+        s->error = true;
+    }
+
+    for (i = 0; i < count && !s->error; i++) {
+        u32 keys = (u32) cacheReadInt(s);
+        long offset = (long) (u32) cacheReadInt(s);
+        u32 payloadSize = (u32) cacheReadInt(s);
+        u32 crc = (u32) cacheReadInt(s);
+        bool hasCrc = cacheReadInt(s) != 0;
+        u32 payload = (u32) cacheReadInt(s);
+        u16 titleLen, pathLen, patchLen, argsLen;
+        const char *title = cacheReadView(s, &titleLen);
+        const char *path = cacheReadView(s, &pathLen);
+        const char *patch = cacheReadView(s, &patchLen);
+        const char *args = cacheReadView(s, &argsLen);
+        if (s->error) {
+            break;
+        }
+
+        char *tmp = malloc((size_t) titleLen + pathLen + 2);
+        if (!tmp) {
+            s->error = true;
+            break;
+        }
+        memcpy(tmp, title, titleLen);
+        tmp[titleLen] = '\0';
+        memcpy(tmp + titleLen + 1, path, pathLen);
+        tmp[titleLen + 1 + pathLen] = '\0';
+
+        boot_entry_s *entry = configNewEntry(cfg, tmp, tmp + titleLen + 1);
+        free(tmp);
+        if (!entry) {
+            s->error = true;
+            break;
+        }
+        entry->keys = keys;
+        entry->offset = offset;
+        entry->size = payloadSize;
+        entry->crc = crc;
+        entry->hasCrc = hasCrc;
+        entry->payload = payload;
+        if (patchLen > 0) {
+            entry->patch = arenaStrndup(&cfg->strings, patch, patchLen);
+            if (!entry->patch) {
+                s->error = true;
+            }
+        }
+        if (argsLen > 0) {
+            char *copy = arenaAlloc(&cfg->strings, argsLen);
+            if (!copy) {
+                s->error = true;
+                break;
+            }
+            memcpy(copy, args, argsLen);
+            entry->args = copy;
+            entry->argsLen = argsLen;
+        }
+    }
+}
+
+static void cacheWriteProfile(cache_stream_s *s, boot_config_s *cfg) {
+
+    cacheWriteStr(s, cfg->name, 0x10000);
+    cacheWriteInt(s, (s32) cfg->profileKeys);
+    cacheWriteInt(s, cfg->count);
+
+    int i;
+    for (i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_schema_s *setting = &config_schema[i];
+        switch (setting->type) {
+            case CONFIG_SCHEMA_COLOR:
+                cacheWrite(s, configSchemaData(cfg, setting), sizeof(u8[3]));
+                break;
+            case CONFIG_SCHEMA_PATH:
+                cacheWriteStr(s, (const char *) configSchemaData(cfg, setting), setting->size);
+                break;
+            default:
+                cacheWriteInt(s, *configSchemaInt(cfg, setting));
+                break;
+        }
+    }
+
+    for (i = 0; i < cfg->count; i++) {
+        cacheWriteInt(s, (s32) cfg->entries[i].keys);
+        cacheWriteInt(s, (s32) cfg->entries[i].offset);
+        cacheWriteInt(s, (s32) cfg->entries[i].size);
+        cacheWriteInt(s, (s32) cfg->entries[i].crc);
+        cacheWriteInt(s, cfg->entries[i].hasCrc);
+        cacheWriteInt(s, (s32) cfg->entries[i].payload);
+        cacheWriteStr(s, cfg->entries[i].title, 0x10000);
+        cacheWriteStr(s, cfg->entries[i].path, 0x10000);
+        cacheWriteStr(s, cfg->entries[i].patch ? cfg->entries[i].patch : "", 0x10000);
+        cacheWriteData(s, cfg->entries[i].args, cfg->entries[i].argsLen);
+    }
+}
+
+int configCacheLoad(const char *cfgPath) {
+
+    u32 cfgSize, cfgMtime;
+    if (configCacheSourceInfo(cfgPath, &cfgSize, &cfgMtime) != 0) {
+        return -1;
+    }
+
+    FILE *file = fopen(CONFIG_CACHE_PATH, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < (long) sizeof(config_cache_header_s)) {
+        fclose(file);
+        return -1;
+    }
+
+    // single read of the whole snapshot
+    u8 *buf = malloc((size_t) size);
+    if (!buf) {
+        fclose(file);
+        return -1;
+    }
+    size_t read = fread(buf, 1, (size_t) size, file);
+    fclose(file);
+    if (read != (size_t) size) {
+        free(buf);
+        return -1;
+    }
+
+    config_cache_header_s hdr;
+    memcpy(&hdr, buf, sizeof(config_cache_header_s));
+    if (hdr.magic != CONFIG_CACHE_MAGIC
+        || hdr.version != CONFIG_CACHE_VERSION
+        || hdr.headerSize != sizeof(config_cache_header_s)
+        || hdr.payloadSize != (u32) size - hdr.headerSize
+        || hdr.cfgSize != cfgSize
+        || hdr.cfgMtime != cfgMtime) {
+        free(buf);
+        return -1;
+    }
+
+    // stale check: size and mtime, the whole boot.cfg is only hashed when they're ambiguous
+    bool ambiguous = cacheAmbiguous(&hdr);
+    if (ambiguous && hdr.cfgCrc != configCacheSourceCrc(cfgPath, cfgSize)) {
+        free(buf);
+        return -1;
+    }
+
+    u8 *payload = buf + hdr.headerSize;
+    if (hdr.payloadCrc != (u32) crc32(crc32(0L, Z_NULL, 0), payload, hdr.payloadSize)) {
+        free(buf);
+        return -1;
+    }
+
+    cache_stream_s s = {payload, hdr.payloadSize, 0, false};
+    int count = cacheReadInt(&s);
+    if (count < 1 || !configAllocProfiles(count)) {
+        free(buf);
+        return -1;
+    }
+
+    int i;
+    for (i = 0; i < count && !s.error; i++) {
+        cacheReadProfile(&s, &profiles[i]);
+    }
+    free(buf);
+
+    if (s.error || s.pos != s.size) {
+        return -1;
+    }
+
+    if (ambiguous) {
+        cacheSettle(&hdr);
+    }
+
+    return 0;
+}
+
+int configCacheWrite(const char *cfgPath) {
+
+    config_cache_header_s hdr;
+    memset(&hdr, 0, sizeof(config_cache_header_s));
+    hdr.magic = CONFIG_CACHE_MAGIC;
+    hdr.version = CONFIG_CACHE_VERSION;
+    hdr.headerSize = sizeof(config_cache_header_s);
+    if (configCacheSourceInfo(cfgPath, &hdr.cfgSize, &hdr.cfgMtime) != 0) {
+        return -1;
+    }
+    hdr.cfgCrc = configCacheSourceCrc(cfgPath, hdr.cfgSize);
+    hdr.writeTime = (u32) time(NULL);
+
+    int i;
+    size_t size = sizeof(config_cache_header_s) + sizeof(s32);
+    for (i = 0; i < profileCount; i++) {
+        size += cacheProfileSize(&profiles[i]);
+    }
+    u8 *buf = malloc(size);
+    if (!buf) {
+        return -1;
+    }
+
+    cache_stream_s s = {buf + sizeof(config_cache_header_s), size - sizeof(config_cache_header_s), 0, false};
+    cacheWriteInt(&s, profileCount);
+    for (i = 0; i < profileCount; i++) {
+        cacheWriteProfile(&s, &profiles[i]);
+    }
+
+    if (s.error || s.pos != s.size) {
+        free(buf);
+        return -1;
+    }
+
+    hdr.payloadSize = (u32) s.size;
+    hdr.payloadCrc = (u32) crc32(crc32(0L, Z_NULL, 0), s.buf, (uInt) s.size);
+    memcpy(buf, &hdr, sizeof(config_cache_header_s));
+
+    FILE *file = fopen(CONFIG_CACHE_PATH, "wb");
+    if (file == NULL) {
+        free(buf);
+        return -1;
+    }
+    size_t written = fwrite(buf, 1, size, file);
+    fclose(file);
+    free(buf);
+
+    if (written != size) {
+        configCacheInvalidate();
+        return -1;
+    }
+
+    return 0;
+}
+
+void configCacheInvalidate() {
+    remove(CONFIG_CACHE_PATH);
+}
@@ -0,0 +1,37 @@
+#ifndef _config_cache_h_
+#define _config_cache_h_
+
+#include "config.h"
+
+#define CONFIG_CACHE_PATH "/boot.cfg.bin"
+#define CONFIG_CACHE_MAGIC 0x47464342 // 'BCFG'
+#define CONFIG_CACHE_VERSION 10
+// a boot.cfg mtime this close to the cache write can hide a same size rewrite (fat: 2 seconds)
+#define CONFIG_CACHE_MTIME_RESOLUTION 2
+
+// binary snapshot of the resolved profiles, stored next to boot.cfg
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 headerSize;
+    u32 cfgSize;        // size of boot.cfg when the cache was written
+    u32 cfgMtime;       // mtime of boot.cfg (0 if the fs doesn't provide it)
+    u32 cfgCrc;         // crc32 of boot.cfg, checked when size and mtime are ambiguous
+    u32 writeTime;      // when the cache was written (or last found fresh)
+    u32 payloadSize;
+    u32 payloadCrc;
+} config_cache_header_s;
+
+int configCacheLoad(const char *cfgPath);
+
+int configCacheWrite(const char *cfgPath);
+
+void configCacheInvalidate();
+
+// size and mtime (0 if the fs doesn't provide it) of boot.cfg
+int configCacheSourceInfo(const char *cfgPath, u32 *size, u32 *mtime);
+
+// crc32 of the whole boot.cfg
+u32 configCacheSourceCrc(const char *cfgPath, u32 size);
+
+#endif // _config_cache_h_
@@ -0,0 +1,278 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <zlib.h>
+#include "config_journal.h"
+#include "config_cache.h"
+#include "config_schema.h"
+
+static const char *journal_cfg = NULL;
+static int journal_count = 0;
+static bool journal_torn = false;
+
+static u32 journalCrc(const config_journal_record_s *rec, const u8 *data) {
+    u32 crc = (u32) crc32(0L, Z_NULL, 0);
+    crc = (u32) crc32(crc, (const Bytef *) rec, sizeof(config_journal_record_s));
+    return (u32) crc32(crc, data, rec->size);
+}
+
+// settings saved by a SETTINGS record, in schema order
+static bool journalSetting(const config_schema_s *s) {
+    return configSchemaIsInt(s) && !(s->flags & (CONFIG_SCHEMA_THEME | CONFIG_SCHEMA_MAIN));
+}
+
+static int journalApply(const config_journal_record_s *rec, const u8 *data) {
+
+    if (rec->profile >= profileCount) {
+        return -1;
+    }
+    boot_config_s *cfg = &profiles[rec->profile];
+
+    switch (rec->type) {
+        case CONFIG_JOURNAL_ADD: {
+            s32 offset;
+            u32 keys;
+            u16 titleLen, pathLen;
+            if (rec->size < 2 * sizeof(s32) + 2 * sizeof(u16)) {
+                return -1;
+            }
+            memcpy(&offset, data, sizeof(s32));
+            memcpy(&keys, data + 4, sizeof(u32));
+            memcpy(&titleLen, data + 8, sizeof(u16));
+            memcpy(&pathLen, data + 10, sizeof(u16));
+            if (rec->size != 12 + titleLen + pathLen + 2) {
+                return -1;
+            }
+            // strings are stored with their terminator
+            const char *title = (const char *) data + 12;
+            const char *path = title + titleLen + 1;
+            if (title[titleLen] != '\0' || path[pathLen] != '\0') {
+                return -1;
+            }
+            boot_entry_s *entry = configNewEntry(cfg, title, path);
+            if (!entry) {
+                return -1;
+            }
+            entry->offset = (long) (u32) offset;
+            entry->keys = keys;
+            return 0;
+        }
+
+        case CONFIG_JOURNAL_REMOVE: {
+            s32 index;
+            if (rec->size != sizeof(s32)) {
+                return -1;
+            }
+            memcpy(&index, data, sizeof(s32));
+            return configDeleteEntry(cfg, index);
+        }
+
+        case CONFIG_JOURNAL_SETTINGS: {
+            int i, count = 0;
+            for (i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+                if (journalSetting(&config_schema[i])) {
+                    count++;
+                }
+            }
+            if (rec->size != count * sizeof(s32)) {
+                return -1;
+            }
+            for (i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+                if (journalSetting(&config_schema[i])) {
+                    s32 value;
+                    memcpy(&value, data, sizeof(s32));
+                    *configSchemaInt(cfg, &config_schema[i]) = value;
+                    data += sizeof(s32);
+                }
+            }
+            // bootfix and recovery key are shared by all profiles
+            configSchemaShare(cfg);
+            return 0;
+        }
+
+        default:
+            return -1;
+    }
+}
+
+// boot.cfg is still the file the journal was started for
+static bool journalCurrent(const config_journal_header_s *hdr) {
+
+    u32 size, mtime;
+    if (hdr->generation != profiles[0].generation
+        || configCacheSourceInfo(journal_cfg, &size, &mtime) != 0
+        || hdr->cfgSize != size || hdr->cfgMtime != mtime) {
+        return false;
+    }
+    // same rule as the cache: a rewrite within the mtime resolution keeps size and mtime
+    bool ambiguous = mtime == 0 || (s32) (hdr->writeTime - mtime) < CONFIG_CACHE_MTIME_RESOLUTION;
+    return !ambiguous || hdr->cfgCrc == configCacheSourceCrc(journal_cfg, size);
+}
+
+// apply pending changes on top of the config loaded from boot.cfg (or its cache)
+int configJournalReplay(const char *cfgPath) {
+
+    journal_cfg = cfgPath;
+    journal_count = 0;
+    journal_torn = false;
+
+    FILE *file = fopen(CONFIG_JOURNAL_PATH, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < (long) sizeof(config_journal_header_s)) {
+        fclose(file);
+        configJournalClear();
+        return 0;
+    }
+
+    u8 *buf = malloc((size_t) size);
+    if (!buf || fread(buf, 1, (size_t) size, file) != (size_t) size) {
+        free(buf);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    config_journal_header_s hdr;
+    memcpy(&hdr, buf, sizeof(config_journal_header_s));
+    if (hdr.magic != CONFIG_JOURNAL_MAGIC
+        || hdr.version != CONFIG_JOURNAL_VERSION
+        || !journalCurrent(&hdr)) {
+        // written against another boot.cfg: already compacted, edited by hand, or garbage
+        free(buf);
+        configJournalClear();
+        return 0;
+    }
+
+    long pos = sizeof(config_journal_header_s);
+    while (pos < size) {
+        config_journal_record_s rec;
+        u32 crc;
+        if (pos + (long) sizeof(config_journal_record_s) > size) {
+            journal_torn = true;
+            break;
+        }
+        memcpy(&rec, buf + pos, sizeof(config_journal_record_s));
+        const u8 *data = buf + pos + sizeof(config_journal_record_s);
+        if (pos + (long) sizeof(config_journal_record_s) + rec.size + (long) sizeof(u32) > size) {
+            journal_torn = true;
+            break;
+        }
+        memcpy(&crc, data + rec.size, sizeof(u32));
+        // a power loss during an append leaves a bad tail, stop there
+        if (crc != journalCrc(&rec, data) || journalApply(&rec, data) != 0) {
+            journal_torn = true;
+            break;
+        }
+        journal_count++;
+        pos += sizeof(config_journal_record_s) + rec.size + sizeof(u32);
+    }
+
+    free(buf);
+    return 0;
+}
+
+static int journalAppend(u8 type, int profile, const u8 *data, u16 size) {
+
+    // don't append after a torn record, it would never be replayed
+    if (journal_torn || !journal_cfg) {
+        return -1;
+    }
+
+    FILE *file = fopen(CONFIG_JOURNAL_PATH, "ab");
+    if (file == NULL) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0) {
+        config_journal_header_s hdr = {CONFIG_JOURNAL_MAGIC, CONFIG_JOURNAL_VERSION, 0, profiles[0].generation,
+                                       0, 0, 0, 0};
+        if (configCacheSourceInfo(journal_cfg, &hdr.cfgSize, &hdr.cfgMtime) != 0) {
+            fclose(file);
+            remove(CONFIG_JOURNAL_PATH);
+            return -1;
+        }
+        hdr.cfgCrc = configCacheSourceCrc(journal_cfg, hdr.cfgSize);
+        hdr.writeTime = (u32) time(NULL);
+        fwrite(&hdr, 1, sizeof(config_journal_header_s), file);
+    }
+
+    config_journal_record_s rec = {type, (u8) profile, size};
+    u32 crc = journalCrc(&rec, data);
+    size_t written = fwrite(&rec, 1, sizeof(config_journal_record_s), file);
+    written += fwrite(data, 1, size, file);
+    written += fwrite(&crc, 1, sizeof(u32), file);
+    fflush(file);
+    fclose(file);
+
+    if (written != sizeof(config_journal_record_s) + size + sizeof(u32)) {
+        journal_torn = true;
+        return -1;
+    }
+
+    journal_count++;
+    return 0;
+}
+
+int configJournalAdd(int profile, boot_entry_s *entry) {
+
+    size_t titleLen = strlen(entry->title), pathLen = strlen(entry->path);
+    size_t size = 12 + titleLen + pathLen + 2;
+    if (size > 0xFFFF) {
+        return -1;
+    }
+
+    u8 *data = malloc(size);
+    if (!data) {
+        return -1;
+    }
+    s32 offset = (s32) entry->offset;
+    u32 keys = entry->keys;
+    u16 len;
+    memcpy(data, &offset, sizeof(s32));
+    memcpy(data + 4, &keys, sizeof(u32));
+    len = (u16) titleLen;
+    memcpy(data + 8, &len, sizeof(u16));
+    len = (u16) pathLen;
+    memcpy(data + 10, &len, sizeof(u16));
+    memcpy(data + 12, entry->title, titleLen + 1);
+    memcpy(data + 12 + titleLen + 1, entry->path, pathLen + 1);
+
+    int ret = journalAppend(CONFIG_JOURNAL_ADD, profile, data, (u16) size);
+    free(data);
+    return ret;
+}
+
+int configJournalRemove(int profile, int index) {
+    s32 i = index;
+    return journalAppend(CONFIG_JOURNAL_REMOVE, profile, (const u8 *) &i, sizeof(s32));
+}
+
+int configJournalSettings(int profile) {
+    boot_config_s *cfg = &profiles[profile];
+    s32 values[CONFIG_SCHEMA_COUNT];
+    int i, count = 0;
+    for (i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        if (journalSetting(&config_schema[i])) {
+            values[count++] = *configSchemaInt(cfg, &config_schema[i]);
+        }
+    }
+    return journalAppend(CONFIG_JOURNAL_SETTINGS, profile, (const u8 *) values, (u16) (count * sizeof(s32)));
+}
+
+int configJournalCount() {
+    return journal_torn ? CONFIG_JOURNAL_MAX : journal_count;
+}
+
+void configJournalClear() {
+    remove(CONFIG_JOURNAL_PATH);
+    journal_count = 0;
+    journal_torn = false;
+}
@@ -0,0 +1,50 @@
+#ifndef _config_journal_h_
+#define _config_journal_h_
+
+#include "config.h"
+
+#define CONFIG_JOURNAL_PATH "/boot.cfg.log"
+#define CONFIG_JOURNAL_MAGIC 0x4c4e4a42 // 'BJNL'
+#define CONFIG_JOURNAL_VERSION 6
+// compact into boot.cfg once that many changes are pending
+#define CONFIG_JOURNAL_MAX 16
+
+enum {
+    CONFIG_JOURNAL_ADD = 1,
+    CONFIG_JOURNAL_REMOVE = 2,
+    CONFIG_JOURNAL_SETTINGS = 3
+};
+
+// the journal only applies on top of the boot.cfg it was started for:
+// same generation, and the same file (a hand edit keeps the generation)
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 reserved;
+    s32 generation;
+    u32 cfgSize;        // size of boot.cfg when the journal was started
+    u32 cfgMtime;       // mtime of boot.cfg (0 if the fs doesn't provide it)
+    u32 cfgCrc;         // crc32 of boot.cfg, checked when size and mtime are ambiguous
+    u32 writeTime;      // when the journal was started
+} config_journal_header_s;
+
+// followed by size bytes of data and the crc32 of type, size and data
+typedef struct {
+    u8 type;
+    u8 profile;     // index in the profiles table
+    u16 size;
+} config_journal_record_s;
+
+int configJournalReplay(const char *cfgPath);
+
+int configJournalAdd(int profile, boot_entry_s *entry);
+
+int configJournalRemove(int profile, int index);
+
+int configJournalSettings(int profile);
+
+int configJournalCount();
+
+void configJournalClear();
+
+#endif // _config_journal_h_
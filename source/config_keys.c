@@ -0,0 +1,153 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config_keys.h"
+
+// keys of profiles[1..], checked before the entries of the selected profile
+static boot_keymap_s profile_keymap = {
+        .single = {[0 ... 31] = -1}
+};
+
+void keymapInit(boot_keymap_s *map) {
+    memset(map->single, 0xFF, sizeof(map->single));
+    map->chords = NULL;
+    map->chordCount = 0;
+    map->chordCapacity = 0;
+}
+
+void keymapFree(boot_keymap_s *map) {
+    free(map->chords);
+    keymapInit(map);
+}
+
+// bind keys to target, -1 if these keys are already bound
+int keymapAdd(boot_keymap_s *map, u32 keys, int target) {
+
+    if (!keys) {
+        return -1;
+    }
+
+    // single button: direct slot
+    if (!(keys & (keys - 1))) {
+        int bit = __builtin_ctz(keys);
+        if (map->single[bit] >= 0) {
+            return -1;
+        }
+        map->single[bit] = (s16) target;
+        return 0;
+    }
+
+    int i;
+    for (i = 0; i < map->chordCount; i++) {
+        if (map->chords[i].keys == keys) {
+            return -1;
+        }
+    }
+
+    if (map->chordCount >= map->chordCapacity) {
+        int capacity = map->chordCapacity > 0 ? map->chordCapacity * 2 : 4;
+        boot_binding_s *chords = realloc(map->chords, capacity * sizeof(boot_binding_s));
+        if (!chords) {
+            return -1;
+        }
+        map->chords = chords;
+        map->chordCapacity = capacity;
+    }
+
+    // longest chords first, so L+R+A wins over L+A
+    int bits = __builtin_popcount(keys);
+    for (i = map->chordCount; i > 0 && __builtin_popcount(map->chords[i - 1].keys) < bits; i--) {
+        map->chords[i] = map->chords[i - 1];
+    }
+    map->chords[i].keys = keys;
+    map->chords[i].target = target;
+    map->chordCount++;
+
+    return 0;
+}
+
+// target bound to the held keys, -1 if none
+int keymapLookup(const boot_keymap_s *map, u32 held) {
+
+    int i;
+    for (i = 0; i < map->chordCount; i++) {
+        if ((held & map->chords[i].keys) == map->chords[i].keys) {
+            return map->chords[i].target;
+        }
+    }
+
+    // usually a single button is held, one slot to look at
+    while (held) {
+        int target = map->single[__builtin_ctz(held)];
+        if (target >= 0) {
+            return target;
+        }
+        held &= held - 1;
+    }
+
+    return -1;
+}
+
+// configResolveKeys takes the profile keys out of the held mask,
+// an entry sharing any of them (profile L, entry L+A) can never match
+static bool keymapBoundToProfile(u32 keys) {
+    int i;
+    for (i = 1; i < profileCount; i++) {
+        if (profiles[i].profileKeys & keys && !profiles[i].profileKeyConflict) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void configFreeKeymaps() {
+    keymapFree(&profile_keymap);
+    int i;
+    for (i = 0; i < profileCount; i++) {
+        keymapFree(&profiles[i].keymap);
+    }
+}
+
+void configBuildKeymaps() {
+
+    configFreeKeymaps();
+    if (!profiles) {
+        return;
+    }
+
+    // the recovery key always enters the menu, nothing else can use it
+    u32 recovery = profiles[0].recovery >= 0 && profiles[0].recovery < 32 ? BIT(profiles[0].recovery) : 0;
+
+    // first binding wins, the later ones are flagged and ignored
+    int i, j;
+    for (i = 1; i < profileCount; i++) {
+        boot_config_s *cfg = &profiles[i];
+        cfg->profileKeyConflict = cfg->profileKeys
+                                  && (cfg->profileKeys & recovery
+                                      || keymapAdd(&profile_keymap, cfg->profileKeys, i) != 0);
+    }
+
+    for (i = 0; i < profileCount; i++) {
+        boot_config_s *cfg = &profiles[i];
+        for (j = 0; j < cfg->count; j++) {
+            boot_entry_s *entry = &cfg->entries[j];
+            entry->keyConflict = entry->keys
+                                 && (entry->keys & recovery
+                                     || keymapBoundToProfile(entry->keys)
+                                     || keymapAdd(&cfg->keymap, entry->keys, j) != 0);
+        }
+    }
+}
+
+int configResolveKeys(u32 held) {
+
+    int profile = keymapLookup(&profile_keymap, held);
+    if (profile >= 0) {
+        configSelectProfile(profile);
+        // the profile keys don't pick an entry as well
+        held &= ~profiles[profile].profileKeys;
+    }
+
+    return keymapLookup(&config->keymap, held);
+}
@@ -0,0 +1,23 @@
+#ifndef _config_keys_h_
+#define _config_keys_h_
+
+#include "config.h"
+
+// builds the key tables of every profile, flags conflicting bindings
+void configBuildKeymaps();
+
+void configFreeKeymaps();
+
+// single lookup for the keys held at power-on: selects the profile
+// bound to them and returns the entry to boot, -1 if none
+int configResolveKeys(u32 held);
+
+void keymapInit(boot_keymap_s *map);
+
+int keymapAdd(boot_keymap_s *map, u32 keys, int target);
+
+int keymapLookup(const boot_keymap_s *map, u32 held);
+
+void keymapFree(boot_keymap_s *map);
+
+#endif // _config_keys_h_
@@ -0,0 +1,173 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "config_schema.h"
+
+#define CONFIG_SCHEMA_DESC(field, name, label, type, def, min, max, flags) \
+    {name, label, CONFIG_SCHEMA_##type, flags, \
+     offsetof(boot_config_s, field), sizeof(((boot_config_s *) 0)->field), def, min, max},
+
+const config_schema_s config_schema[CONFIG_SCHEMA_COUNT] = {
+        CONFIG_SCHEMA(CONFIG_SCHEMA_DESC)
+};
+
+#undef CONFIG_SCHEMA_DESC
+
+static void setColor(u8 *cfgColor, const char *color) {
+    long l = strtoul(color, NULL, 16);
+    cfgColor[0] = (u8) (l >> 16 & 0xFF);
+    cfgColor[1] = (u8) (l >> 8 & 0xFF);
+    cfgColor[2] = (u8) (l & 0xFF);
+}
+
+static const config_schema_s *schemaFind(const char *name, u8 scope) {
+    int i;
+    for (i = 0; name && i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_schema_s *s = &config_schema[i];
+        if ((s->flags & CONFIG_SCHEMA_THEME) == scope && strcmp(s->name, name) == 0) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+void configSchemaDefaults(boot_config_s *cfg) {
+    int i;
+    for (i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_schema_s *s = &config_schema[i];
+        u8 *data = configSchemaData(cfg, s);
+        switch (s->type) {
+            case CONFIG_SCHEMA_COLOR:
+                data[0] = (u8) (s->def >> 16 & 0xFF);
+                data[1] = (u8) (s->def >> 8 & 0xFF);
+                data[2] = (u8) (s->def & 0xFF);
+                break;
+            case CONFIG_SCHEMA_PATH:
+                data[0] = '\0';
+                break;
+            default:
+                *configSchemaInt(cfg, s) = s->def;
+                break;
+        }
+    }
+}
+
+void configSchemaInherit(boot_config_s *cfg, const boot_config_s *from) {
+    int i;
+    for (i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_schema_s *s = &config_schema[i];
+        if (s->flags & (CONFIG_SCHEMA_INHERIT | CONFIG_SCHEMA_SHARED)) {
+            memcpy((u8 *) cfg + s->offset, (const u8 *) from + s->offset, s->size);
+        }
+    }
+}
+
+// copy the shared settings of one profile to all of them
+void configSchemaShare(const boot_config_s *from) {
+    int i, j;
+    for (i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_schema_s *s = &config_schema[i];
+        if (!(s->flags & CONFIG_SCHEMA_SHARED)) {
+            continue;
+        }
+        for (j = 0; j < profileCount; j++) {
+            memcpy((u8 *) &profiles[j] + s->offset, (const u8 *) from + s->offset, s->size);
+        }
+    }
+}
+
+// out of range values fall back to their default
+void configSchemaClamp(boot_config_s *cfg) {
+    int i;
+    for (i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_schema_s *s = &config_schema[i];
+        if (!configSchemaIsInt(s)) {
+            continue;
+        }
+        int *value = configSchemaInt(cfg, s);
+        int max = s->type == CONFIG_SCHEMA_ENTRY ? cfg->count - 1 : s->max;
+        if (*value < s->min || *value > max) {
+            *value = s->def;
+        }
+    }
+}
+
+static void schemaReadGroup(boot_config_s *cfg, config_setting_t *group, u8 scope) {
+
+    // single pass over what the group contains
+    int i, count = config_setting_length(group);
+    for (i = 0; i < count; i++) {
+        config_setting_t *setting = config_setting_get_elem(group, (unsigned int) i);
+        const config_schema_s *s = schemaFind(config_setting_name(setting), scope);
+        if (!s) {
+            continue;
+        }
+
+        const char *str;
+        switch (s->type) {
+            case CONFIG_SCHEMA_COLOR:
+                if ((str = config_setting_get_string(setting))) {
+                    setColor(configSchemaData(cfg, s), str);
+                }
+                break;
+            case CONFIG_SCHEMA_PATH:
+                if ((str = config_setting_get_string(setting))) {
+                    char *path = (char *) configSchemaData(cfg, s);
+                    strncpy(path, str, s->size - 1);
+                    path[s->size - 1] = '\0';
+                }
+                break;
+            default:
+                if (config_setting_type(setting) == CONFIG_TYPE_INT) {
+                    *configSchemaInt(cfg, s) = config_setting_get_int(setting);
+                }
+                break;
+        }
+    }
+}
+
+void configSchemaRead(boot_config_s *cfg, config_setting_t *group) {
+    schemaReadGroup(cfg, group, 0);
+    config_setting_t *theme = config_setting_lookup(group, "theme");
+    if (theme) {
+        schemaReadGroup(cfg, theme, CONFIG_SCHEMA_THEME);
+    }
+}
+
+// write the settings back to a boot_config (main) or profile group
+void configSchemaWrite(const boot_config_s *cfg, config_setting_t *group, bool main) {
+    int i;
+    for (i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_schema_s *s = &config_schema[i];
+        if (!configSchemaIsInt(s) || s->flags & CONFIG_SCHEMA_THEME
+            || (!main && s->flags & (CONFIG_SCHEMA_SHARED | CONFIG_SCHEMA_MAIN))) {
+            continue;
+        }
+        config_setting_t *setting = config_setting_lookup(group, s->name);
+        if (!setting) {
+            setting = config_setting_add(group, s->name, CONFIG_TYPE_INT);
+        }
+        if (setting) {
+            config_setting_set_int(setting, *configSchemaInt((boot_config_s *) cfg, s));
+        }
+    }
+}
+
+// settings menu left/right
+void configSchemaStep(boot_config_s *cfg, const config_schema_s *s, int step) {
+
+    int *value = configSchemaInt(cfg, s);
+    int max = s->type == CONFIG_SCHEMA_ENTRY ? cfg->count - 1 : s->max;
+    if (max < s->min) {
+        return;
+    }
+
+    *value += step;
+    if (*value < s->min) {
+        *value = s->flags & CONFIG_SCHEMA_WRAP ? max : s->min;
+    } else if (*value > max) {
+        *value = s->flags & CONFIG_SCHEMA_WRAP ? s->min : max;
+    }
+}
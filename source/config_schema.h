@@ -0,0 +1,91 @@
+#ifndef _config_schema_h_
+#define _config_schema_h_
+
+#include <libconfig.h>
+#include "config.h"
+
+// every boot_config_s setting read from boot.cfg, in settings menu order:
+//  X(field, name in boot.cfg, menu label, type, default, min, max, flags)
+#define CONFIG_SCHEMA(X) \
+    X(timeout,     "timeout",     "Timeout",      INT,    3,        -1, 3600,     CONFIG_SCHEMA_MENU | CONFIG_SCHEMA_INHERIT) \
+    X(index,       "default",     "Default",      ENTRY,  0,        0,  0,        CONFIG_SCHEMA_MENU | CONFIG_SCHEMA_WRAP) \
+    X(autobootfix, "autobootfix", "Bootfix",      INT,    8,        0,  1000,     CONFIG_SCHEMA_MENU | CONFIG_SCHEMA_SHARED) \
+    X(recovery,    "recovery",    "Recovery key", BUTTON, 2,        0,  11,       CONFIG_SCHEMA_MENU | CONFIG_SCHEMA_SHARED | CONFIG_SCHEMA_WRAP) \
+    X(trace,       "trace",       "Boot trace",   INT,    0,        0,  1,        CONFIG_SCHEMA_MENU | CONFIG_SCHEMA_SHARED | CONFIG_SCHEMA_WRAP) \
+    X(generation,  "generation",  NULL,           INT,    0,        0,  0x7FFFFFFF, CONFIG_SCHEMA_MAIN | CONFIG_SCHEMA_INHERIT) \
+    X(bgTop1,      "bgTop1",      NULL,           COLOR,  0x4a0031, 0,  0xFFFFFF, CONFIG_SCHEMA_THEME | CONFIG_SCHEMA_INHERIT) \
+    X(bgTop2,      "bgTop2",      NULL,           COLOR,  0x6f0149, 0,  0xFFFFFF, CONFIG_SCHEMA_THEME | CONFIG_SCHEMA_INHERIT) \
+    X(bgBot,       "bgBottom",    NULL,           COLOR,  0x6f0149, 0,  0xFFFFFF, CONFIG_SCHEMA_THEME | CONFIG_SCHEMA_INHERIT) \
+    X(highlight,   "highlight",   NULL,           COLOR,  0xdcdcdc, 0,  0xFFFFFF, CONFIG_SCHEMA_THEME | CONFIG_SCHEMA_INHERIT) \
+    X(borders,     "borders",     NULL,           COLOR,  0xffffff, 0,  0xFFFFFF, CONFIG_SCHEMA_THEME | CONFIG_SCHEMA_INHERIT) \
+    X(fntDef,      "font1",       NULL,           COLOR,  0xffffff, 0,  0xFFFFFF, CONFIG_SCHEMA_THEME | CONFIG_SCHEMA_INHERIT) \
+    X(fntSel,      "font2",       NULL,           COLOR,  0x000000, 0,  0xFFFFFF, CONFIG_SCHEMA_THEME | CONFIG_SCHEMA_INHERIT) \
+    X(bgImgTop,    "bgImgTop",    NULL,           PATH,   0,        0,  0,        CONFIG_SCHEMA_THEME | CONFIG_SCHEMA_INHERIT) \
+    X(bgImgBot,    "bgImgBot",    NULL,           PATH,   0,        0,  0,        CONFIG_SCHEMA_THEME | CONFIG_SCHEMA_INHERIT)
+
+enum {
+    CONFIG_SCHEMA_INT,      // int
+    CONFIG_SCHEMA_ENTRY,    // int, index in entries
+    CONFIG_SCHEMA_BUTTON,   // int, key number
+    CONFIG_SCHEMA_COLOR,    // u8[3], "rrggbb" in boot.cfg
+    CONFIG_SCHEMA_PATH      // char[], string in boot.cfg
+};
+
+enum {
+    CONFIG_SCHEMA_MENU = BIT(0),    // shown in the settings menu
+    CONFIG_SCHEMA_WRAP = BIT(1),    // menu wraps around at min/max
+    CONFIG_SCHEMA_SHARED = BIT(2),  // same value in all profiles, stored in boot_config
+    CONFIG_SCHEMA_MAIN = BIT(3),    // only stored in boot_config
+    CONFIG_SCHEMA_INHERIT = BIT(4), // profiles start with the boot_config value
+    CONFIG_SCHEMA_THEME = BIT(5)    // stored in the "theme" group, never written back
+};
+
+typedef struct {
+    const char *name;
+    const char *label;
+    u8 type;
+    u8 flags;
+    u16 offset;
+    u16 size;
+    int def;
+    int min;
+    int max;
+} config_schema_s;
+
+#define CONFIG_SCHEMA_ID(field, name, label, type, def, min, max, flags) CONFIG_SETTING_##field,
+enum {
+    CONFIG_SCHEMA(CONFIG_SCHEMA_ID)
+    CONFIG_SCHEMA_COUNT
+};
+#undef CONFIG_SCHEMA_ID
+
+extern const config_schema_s config_schema[CONFIG_SCHEMA_COUNT];
+
+// settings stored in an int (INT, ENTRY, BUTTON)
+static inline bool configSchemaIsInt(const config_schema_s *s) {
+    return s->type <= CONFIG_SCHEMA_BUTTON;
+}
+
+static inline int *configSchemaInt(boot_config_s *cfg, const config_schema_s *s) {
+    return (int *) ((u8 *) cfg + s->offset);
+}
+
+static inline u8 *configSchemaData(boot_config_s *cfg, const config_schema_s *s) {
+    return (u8 *) cfg + s->offset;
+}
+
+void configSchemaDefaults(boot_config_s *cfg);
+
+void configSchemaInherit(boot_config_s *cfg, const boot_config_s *from);
+
+void configSchemaShare(const boot_config_s *from);
+
+void configSchemaClamp(boot_config_s *cfg);
+
+void configSchemaRead(boot_config_s *cfg, config_setting_t *group);
+
+void configSchemaWrite(const boot_config_s *cfg, config_setting_t *group, bool main);
+
+void configSchemaStep(boot_config_s *cfg, const config_schema_s *s, int step);
+
+#endif // _config_schema_h_
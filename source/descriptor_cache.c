@@ -0,0 +1,310 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "descriptor_cache.h"
+#include "utility.h"
+
+// file layout (little endian, packed): header, then count records, newest first
+// record:
+//  u16 pathLen, char path[pathLen], u32 xmlSize, u32 xmlMtime, u32 writeTime, u32 xmlCrc
+//  u8 flags, u8 numTitles, u8 numServices
+//  numTitles * { u64 tid, u8 mediatype }
+//  numServices * { char name[8], s32 priority }
+
+#define DESCRIPTOR_CACHE_SELECTABLE BIT(0)
+#define DESCRIPTOR_CACHE_AUTODETECT BIT(1)
+#define DESCRIPTOR_CACHE_TRUNCATED BIT(2)
+#define DESCRIPTOR_CACHE_NAME 8
+
+typedef struct {
+    u8 *buf;
+    size_t size;
+    size_t pos;
+    bool error;
+} desc_stream_s;
+
+static void descRead(desc_stream_s *s, void *data, size_t len) {
+    if (s->error || s->pos + len > s->size) {
+        s->error = true;
+        return;
+    }
+    memcpy(data, s->buf + s->pos, len);
+    s->pos += len;
+}
+
+static void descWrite(desc_stream_s *s, const void *data, size_t len) {
+    if (s->error || s->pos + len > s->size) {
+        s->error = true;
+        return;
+    }
+    memcpy(s->buf + s->pos, data, len);
+    s->pos += len;
+}
+
+static size_t descRecordSize(size_t pathLen, u32 numTitles, u32 numServices) {
+    return sizeof(u16) + pathLen + 4 * sizeof(u32) + 3
+           + numTitles * (sizeof(u64) + 1) + numServices * (DESCRIPTOR_CACHE_NAME + sizeof(s32));
+}
+
+// size of the record at s->pos, 0 if it's truncated
+static size_t descSkip(desc_stream_s *s) {
+    size_t start = s->pos;
+    u16 pathLen = 0;
+    u8 counts[3] = {0};
+    descRead(s, &pathLen, sizeof(u16));
+    s->pos += pathLen + 4 * sizeof(u32);
+    descRead(s, counts, 3);
+    if (s->error) {
+        return 0;
+    }
+    size_t size = descRecordSize(pathLen, counts[1], counts[2]);
+    if (start + size > s->size) {
+        s->error = true;
+        return 0;
+    }
+    s->pos = start + size;
+    return size;
+}
+
+static void descDecode(desc_stream_s *s, descriptor_s *d, u8 flags, u8 numTitles, u8 numServices) {
+
+    targetTitle_s titles[DESCRIPTOR_TITLES_MAX];
+    serviceRequest_s services[DESCRIPTOR_SERVICES_MAX];
+    if (numTitles > DESCRIPTOR_TITLES_MAX || numServices > DESCRIPTOR_SERVICES_MAX) {
+        s->error = true;
+        return;
+    }
+
+    int i;
+    for (i = 0; i < numTitles; i++) {
+        descRead(s, &titles[i].tid, sizeof(u64));
+        descRead(s, &titles[i].mediatype, 1);
+    }
+    for (i = 0; i < numServices; i++) {
+        memset(services[i].name, 0, sizeof(services[i].name));
+        descRead(s, services[i].name, DESCRIPTOR_CACHE_NAME);
+        s32 priority = 0;
+        descRead(s, &priority, sizeof(s32));
+        services[i].priority = (int) priority;
+    }
+    if (s->error) {
+        return;
+    }
+
+    d->selectTargetProcess = (flags & DESCRIPTOR_CACHE_SELECTABLE) != 0;
+    d->autodetectServices = (flags & DESCRIPTOR_CACHE_AUTODETECT) != 0;
+    d->truncated = (flags & DESCRIPTOR_CACHE_TRUNCATED) != 0;
+    setDescriptorLists(d, titles, numTitles, services, numServices);
+}
+
+// size and mtime alone can't tell: no mtime on this fs, or the .xml was
+// written so close to its record that a rewrite of the same size keeps its mtime
+static bool descAmbiguous(u32 xmlMtime, u32 writeTime) {
+    return xmlMtime == 0 || (s32) (writeTime - xmlMtime) < DESCRIPTOR_CACHE_MTIME_RESOLUTION;
+}
+
+// descriptors are small (DESCRIPTOR_FILE_MAX), hashing one is a single read
+static u32 descCrc(const char *xmlPath, u32 xmlSize) {
+    u32 crc = (u32) crc32(0L, Z_NULL, 0);
+    FILE *file = xmlSize <= DESCRIPTOR_FILE_MAX ? fopen(xmlPath, "rb") : NULL;
+    if (file == NULL) {
+        return crc;
+    }
+    u8 *buf = malloc(xmlSize);
+    if (buf && fread(buf, 1, xmlSize, file) == xmlSize) {
+        crc = (u32) crc32(crc, buf, xmlSize);
+    }
+    free(buf);
+    fclose(file);
+    return crc;
+}
+
+static void descEncode(desc_stream_s *s, const char *path, u32 xmlSize, u32 xmlMtime, u32 writeTime,
+                       u32 xmlCrc, const descriptor_s *d) {
+
+    u16 pathLen = (u16) strlen(path);
+    u8 header[3] = {
+            (u8) ((d->selectTargetProcess ? DESCRIPTOR_CACHE_SELECTABLE : 0)
+                  | (d->autodetectServices ? DESCRIPTOR_CACHE_AUTODETECT : 0)
+                  | (d->truncated ? DESCRIPTOR_CACHE_TRUNCATED : 0)),
+            (u8) d->numTargetTitles,
+            (u8) d->numRequestedServices
+    };
+    descWrite(s, &pathLen, sizeof(u16));
+    descWrite(s, path, pathLen);
+    descWrite(s, &xmlSize, sizeof(u32));
+    descWrite(s, &xmlMtime, sizeof(u32));
+    descWrite(s, &writeTime, sizeof(u32));
+    descWrite(s, &xmlCrc, sizeof(u32));
+    descWrite(s, header, 3);
+
+    u32 i;
+    for (i = 0; i < d->numTargetTitles; i++) {
+        descWrite(s, &d->targetTitles[i].tid, sizeof(u64));
+        descWrite(s, &d->targetTitles[i].mediatype, 1);
+    }
+    for (i = 0; i < d->numRequestedServices; i++) {
+        char name[DESCRIPTOR_CACHE_NAME];
+        strncpy(name, d->requestedServices[i].name, DESCRIPTOR_CACHE_NAME);
+        descWrite(s, name, DESCRIPTOR_CACHE_NAME);
+        s32 priority = d->requestedServices[i].priority;
+        descWrite(s, &priority, sizeof(s32));
+    }
+}
+
+static u8 *descCacheRead(size_t *size) {
+
+    FILE *file = fopen(DESCRIPTOR_CACHE_PATH, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    u8 *buf = len >= (long) sizeof(descriptor_cache_header_s) ? malloc((size_t) len) : NULL;
+    if (buf && fread(buf, 1, (size_t) len, file) != (size_t) len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(file);
+
+    descriptor_cache_header_s *hdr = (descriptor_cache_header_s *) buf;
+    if (buf && (hdr->magic != DESCRIPTOR_CACHE_MAGIC || hdr->version != DESCRIPTOR_CACHE_VERSION)) {
+        free(buf);
+        buf = NULL;
+    }
+    *size = buf ? (size_t) len : 0;
+    return buf;
+}
+
+// new record first, then the previous ones minus the stale one for path
+static void descCacheWrite(const u8 *old, size_t oldSize, const char *path, const char *xmlPath,
+                           u32 xmlSize, u32 xmlMtime, const descriptor_s *d) {
+
+    if (strlen(path) > 0xFFFF || d->numTargetTitles > 0xFF || d->numRequestedServices > 0xFF) {
+        return;
+    }
+
+    size_t recordSize = descRecordSize(strlen(path), d->numTargetTitles, d->numRequestedServices);
+    size_t size = sizeof(descriptor_cache_header_s) + recordSize + oldSize;
+    u8 *buf = malloc(size);
+    if (!buf) {
+        return;
+    }
+
+    // the crc is only needed, and only computed, when the mtime can't be trusted
+    u32 now = (u32) time(NULL);
+    u32 xmlCrc = descAmbiguous(xmlMtime, now) ? descCrc(xmlPath, xmlSize) : 0;
+
+    desc_stream_s out = {buf, size, sizeof(descriptor_cache_header_s), false};
+    descEncode(&out, path, xmlSize, xmlMtime, now, xmlCrc, d);
+    u32 count = 1;
+
+    if (old) {
+        desc_stream_s in = {(u8 *) old, oldSize, sizeof(descriptor_cache_header_s), false};
+        u32 oldCount = ((const descriptor_cache_header_s *) old)->count;
+        u32 i;
+        for (i = 0; i < oldCount && count < DESCRIPTOR_CACHE_MAX; i++) {
+            size_t start = in.pos;
+            u16 pathLen = 0;
+            descRead(&in, &pathLen, sizeof(u16));
+            bool same = !in.error && start + sizeof(u16) + pathLen <= oldSize
+                        && pathLen == strlen(path) && !memcmp(old + in.pos, path, pathLen);
+            in.pos = start;
+            size_t len = descSkip(&in);
+            if (!len) {
+                break;
+            }
+            if (!same) {
+                descWrite(&out, old + start, len);
+                count++;
+            }
+        }
+    }
+
+    descriptor_cache_header_s hdr = {DESCRIPTOR_CACHE_MAGIC, DESCRIPTOR_CACHE_VERSION, count};
+    memcpy(buf, &hdr, sizeof(descriptor_cache_header_s));
+
+    FILE *file = out.error ? NULL : fopen(DESCRIPTOR_CACHE_PATH, "wb");
+    if (file != NULL) {
+        size_t written = fwrite(buf, 1, out.pos, file);
+        fclose(file);
+        if (written != out.pos) {
+            remove(DESCRIPTOR_CACHE_PATH);
+        }
+    }
+    free(buf);
+}
+
+void descriptorCacheLoad(descriptor_s *d, const char *executablePath) {
+
+    // "/3ds/app/app.3dsx" -> "/3ds/app/app.xml"
+    char xmlPath[256];
+    const char *ext = strrchr(executablePath, '.');
+    const char *slash = strrchr(executablePath, '/');
+    int baseLen = (int) (ext && (!slash || ext > slash) ? ext - executablePath : strlen(executablePath));
+    if (snprintf(xmlPath, sizeof(xmlPath), "%.*s.xml", baseLen, executablePath) >= (int) sizeof(xmlPath)) {
+        return;
+    }
+
+    struct stat st;
+    if (stat(xmlPath, &st) != 0) {
+        return; // no descriptor
+    }
+    u32 xmlSize = (u32) st.st_size;
+    u32 xmlMtime = (u32) st.st_mtime;
+
+    size_t size = 0;
+    u8 *cache = descCacheRead(&size);
+    if (cache) {
+        desc_stream_s in = {cache, size, sizeof(descriptor_cache_header_s), false};
+        u32 count = ((descriptor_cache_header_s *) cache)->count;
+        size_t pathLen = strlen(executablePath);
+        u32 i;
+        for (i = 0; i < count && !in.error; i++) {
+            size_t start = in.pos;
+            u16 len = 0;
+            u32 recSize = 0, recMtime = 0, recWriteTime = 0, recCrc = 0;
+            u8 header[3] = {0};
+            descRead(&in, &len, sizeof(u16));
+            bool same = !in.error && in.pos + len <= size
+                        && len == pathLen && !memcmp(cache + in.pos, executablePath, len);
+            in.pos += len;
+            descRead(&in, &recSize, sizeof(u32));
+            descRead(&in, &recMtime, sizeof(u32));
+            descRead(&in, &recWriteTime, sizeof(u32));
+            descRead(&in, &recCrc, sizeof(u32));
+            descRead(&in, header, 3);
+            bool fresh = same && !in.error && recSize == xmlSize && recMtime == xmlMtime
+                         && (!descAmbiguous(recMtime, recWriteTime) || descCrc(xmlPath, xmlSize) == recCrc);
+            if (fresh) {
+                descDecode(&in, d, header[0], header[1], header[2]);
+                if (!in.error) {
+                    free(cache);
+                    return;
+                }
+                break;
+            }
+            in.pos = start;
+            if (!descSkip(&in)) {
+                break;
+            }
+        }
+    }
+
+    // missing or stale: parse it and record it
+    loadDescriptor(d, xmlPath);
+    // said once, the record keeps the flag for later boots
+    if (d->truncated) {
+        debug("Descriptor has more than %i titles or services:\n%s\nThe others are ignored\n",
+              DESCRIPTOR_TITLES_MAX, xmlPath);
+    }
+    descCacheWrite(cache, size, executablePath, xmlPath, xmlSize, xmlMtime, d);
+    free(cache);
+}
@@ -0,0 +1,24 @@
+#ifndef _descriptor_cache_h_
+#define _descriptor_cache_h_
+
+#include "descriptor.h"
+
+// 3dsx descriptors (.xml next to the .3dsx) compiled to binary records
+#define DESCRIPTOR_CACHE_PATH "/boot.desc"
+#define DESCRIPTOR_CACHE_MAGIC 0x43534442 // 'BDSC'
+#define DESCRIPTOR_CACHE_VERSION 3
+#define DESCRIPTOR_CACHE_MAX 32     // executables kept, the least recently added dropped first
+#define DESCRIPTOR_CACHE_MTIME_RESOLUTION 2 // seconds, fat timestamps
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 count;
+} descriptor_cache_header_s;
+
+// load the descriptor of a 3dsx: from its record while the .xml keeps
+// its size and mtime (and crc when the mtime can't tell), else parsed
+// and recorded, nothing if there's no .xml
+void descriptorCacheLoad(descriptor_s *d, const char *executablePath);
+
+#endif // _descriptor_cache_h_
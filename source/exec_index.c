@@ -0,0 +1,317 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "config.h"
+#include "exec_index.h"
+#include "utility.h"
+
+#define EXEC_INDEX_STACK_SIZE 0x4000
+#define EXEC_INDEX_DEPTH 2 // "/3ds/app/app.3dsx"
+#define EXEC_INDEX_CRC_CHUNK 0x8000
+
+static exec_index_header_s exec_index_hdr;
+static exec_index_entry_s exec_index[EXEC_INDEX_MAX];
+static bool exec_index_loaded = false;
+static bool exec_index_dirty = false;
+static LightLock exec_index_lock;
+
+static Thread exec_index_thread = NULL;
+static volatile bool exec_index_quit = false;
+// boot entries to index first, copied since the config may change meanwhile
+static char (*exec_index_pending)[EXEC_INDEX_PATH_MAX] = NULL;
+static int exec_index_pending_count = 0;
+
+static u32 execIndexHash(const char *path) {
+    u32 hash = 2166136261U; // fnv-1a
+    while (*path) {
+        hash = (hash ^ (u8) *path++) * 16777619U;
+    }
+    return hash ? hash : 1; // 0 is an empty slot
+}
+
+static void execIndexLoad() {
+
+    if (exec_index_loaded) {
+        return;
+    }
+    exec_index_loaded = true;
+    LightLock_Init(&exec_index_lock);
+
+    FILE *file = fopen(EXEC_INDEX_PATH, "rb");
+    if (file != NULL) {
+        bool ok = fread(&exec_index_hdr, 1, sizeof(exec_index_header_s), file) == sizeof(exec_index_header_s)
+                  && exec_index_hdr.magic == EXEC_INDEX_MAGIC && exec_index_hdr.version == EXEC_INDEX_VERSION
+                  && exec_index_hdr.next < EXEC_INDEX_MAX
+                  && fread(exec_index, 1, sizeof(exec_index), file) == sizeof(exec_index);
+        fclose(file);
+        if (ok) {
+            return;
+        }
+    }
+
+    memset(exec_index, 0, sizeof(exec_index));
+    exec_index_hdr.magic = EXEC_INDEX_MAGIC;
+    exec_index_hdr.version = EXEC_INDEX_VERSION;
+    exec_index_hdr.next = 0;
+}
+
+static void execIndexSave() {
+
+    if (!exec_index_dirty) {
+        return;
+    }
+
+    FILE *file = fopen(EXEC_INDEX_PATH, "wb");
+    if (file == NULL) {
+        return;
+    }
+    bool ok = fwrite(&exec_index_hdr, 1, sizeof(exec_index_header_s), file) == sizeof(exec_index_header_s)
+              && fwrite(exec_index, 1, sizeof(exec_index), file) == sizeof(exec_index);
+    fclose(file);
+    if (ok) {
+        exec_index_dirty = false;
+    } else {
+        remove(EXEC_INDEX_PATH);
+    }
+}
+
+// with exec_index_lock held
+static exec_index_entry_s *execIndexFind(const char *path, u32 hash) {
+    int i;
+    for (i = 0; i < EXEC_INDEX_MAX; i++) {
+        if (exec_index[i].hash == hash && strcmp(exec_index[i].path, path) == 0) {
+            return &exec_index[i];
+        }
+    }
+    return NULL;
+}
+
+static bool execIndexStat(const char *path, u32 *size, u32 *mtime) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return false;
+    }
+    *size = (u32) st.st_size;
+    *mtime = (u32) st.st_mtime;
+    return true;
+}
+
+// size and mtime alone can't tell: no mtime on this fs, or the file was
+// written so close to its scan that a rewrite of the same size keeps its mtime
+static bool execIndexAmbiguous(u32 mtime, u32 writeTime) {
+    return mtime == 0 || (s32) (writeTime - mtime) < EXEC_INDEX_MTIME_RESOLUTION;
+}
+
+// reads the whole file, about the cost of a scan, so it's only
+// done for ambiguous entries
+static u32 execIndexCrc(const char *path) {
+    u32 crc = (u32) crc32(0L, Z_NULL, 0);
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return crc;
+    }
+    u8 *buf = malloc(EXEC_INDEX_CRC_CHUNK);
+    size_t read;
+    while (buf && (read = fread(buf, 1, EXEC_INDEX_CRC_CHUNK, file)) > 0) {
+        crc = (u32) crc32(crc, buf, (uInt) read);
+    }
+    free(buf);
+    fclose(file);
+    return crc;
+}
+
+// indexed and unchanged since
+static bool execIndexFresh(const char *path, u32 size, u32 mtime, executableMetadata_s *em) {
+
+    // copied, the file is hashed without the lock held
+    exec_index_entry_s entry;
+    u32 hash = execIndexHash(path);
+    LightLock_Lock(&exec_index_lock);
+    exec_index_entry_s *found = execIndexFind(path, hash);
+    bool fresh = found && found->size == size && found->mtime == mtime;
+    if (fresh) {
+        memcpy(&entry, found, sizeof(exec_index_entry_s));
+    }
+    LightLock_Unlock(&exec_index_lock);
+
+    if (fresh && execIndexAmbiguous(entry.mtime, entry.writeTime)) {
+        fresh = execIndexCrc(path) == entry.crc;
+        // once the file is old enough, later lookups can trust its mtime again
+        u32 now = (u32) time(NULL);
+        if (fresh && !execIndexAmbiguous(mtime, now)) {
+            LightLock_Lock(&exec_index_lock);
+            found = execIndexFind(path, hash);
+            if (found && found->size == size && found->mtime == mtime && found->crc == entry.crc) {
+                found->writeTime = now;
+                exec_index_dirty = true;
+            }
+            LightLock_Unlock(&exec_index_lock);
+        }
+    }
+
+    if (fresh && em) {
+        memcpy(em->sectionSizes, entry.sectionSizes, sizeof(em->sectionSizes));
+        memcpy(em->servicesThatMatter, entry.services, sizeof(em->servicesThatMatter));
+        em->scanned = true;
+    }
+
+    return fresh;
+}
+
+static void execIndexStore(const char *path, u32 size, u32 mtime, const executableMetadata_s *em) {
+
+    if (strlen(path) >= EXEC_INDEX_PATH_MAX) {
+        return;
+    }
+
+    u32 now = (u32) time(NULL);
+    u32 crc = execIndexAmbiguous(mtime, now) ? execIndexCrc(path) : 0;
+
+    LightLock_Lock(&exec_index_lock);
+    u32 hash = execIndexHash(path);
+    exec_index_entry_s *entry = execIndexFind(path, hash);
+    if (!entry) {
+        entry = &exec_index[exec_index_hdr.next];
+        exec_index_hdr.next = (exec_index_hdr.next + 1) % EXEC_INDEX_MAX;
+    }
+    memset(entry, 0, sizeof(exec_index_entry_s));
+    entry->hash = hash;
+    entry->size = size;
+    entry->mtime = mtime;
+    entry->writeTime = now;
+    entry->crc = crc;
+    memcpy(entry->sectionSizes, em->sectionSizes, sizeof(entry->sectionSizes));
+    memcpy(entry->services, em->servicesThatMatter, sizeof(entry->services));
+    strcpy(entry->path, path);
+    exec_index_dirty = true;
+    LightLock_Unlock(&exec_index_lock);
+}
+
+static void execIndexFile(const char *path) {
+
+    u32 size, mtime;
+    if (!execIndexStat(path, &size, &mtime) || execIndexFresh(path, size, mtime, NULL)) {
+        return;
+    }
+
+    executableMetadata_s em;
+    initMetadata(&em);
+    scanExecutable(&em, (char *) path);
+    if (em.scanned) {
+        execIndexStore(path, size, mtime, &em);
+    }
+}
+
+static void execIndexDir(const char *path, int depth) {
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return;
+    }
+
+    char child[EXEC_INDEX_PATH_MAX];
+    struct dirent *file;
+    while (!exec_index_quit && (file = readdir(dir))) {
+        if (!strcmp(file->d_name, ".") || !strcmp(file->d_name, "..")) {
+            continue;
+        }
+        bool isDir = file->d_type == DT_DIR;
+        if (!isDir && strcasecmp(get_filename_ext(file->d_name), "3dsx") != 0) {
+            continue;
+        }
+        if (snprintf(child, sizeof(child), "%s%s%s", path, end_with(path, '/') ? "" : "/", file->d_name)
+            >= (int) sizeof(child)) {
+            continue;
+        }
+        if (isDir) {
+            if (depth > 1) {
+                execIndexDir(child, depth - 1);
+            }
+        } else {
+            execIndexFile(child);
+        }
+    }
+
+    closedir(dir);
+}
+
+static void execIndexThread(void *arg) {
+
+    int i;
+    for (i = 0; i < exec_index_pending_count && !exec_index_quit; i++) {
+        execIndexFile(exec_index_pending[i]);
+    }
+    if (!exec_index_quit) {
+        execIndexDir("/", 1);
+    }
+    if (!exec_index_quit) {
+        execIndexDir("/3ds", EXEC_INDEX_DEPTH);
+    }
+}
+
+void execIndexStart() {
+
+    if (exec_index_thread) {
+        return;
+    }
+    execIndexLoad();
+
+    // 3dsx boot entries first, they're the likely launches
+    free(exec_index_pending);
+    exec_index_pending_count = 0;
+    exec_index_pending = config ? malloc(config->count * sizeof(*exec_index_pending)) : NULL;
+    int i;
+    for (i = 0; exec_index_pending && i < config->count; i++) {
+        const char *path = config->entries[i].path;
+        if (strcasecmp(get_filename_ext(path), "3dsx") == 0 && strlen(path) < EXEC_INDEX_PATH_MAX) {
+            strcpy(exec_index_pending[exec_index_pending_count++], path);
+        }
+    }
+
+    // below the main thread, like the payload prefetch
+    s32 prio = 0x30;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    exec_index_quit = false;
+    exec_index_thread = threadCreate(execIndexThread, NULL, EXEC_INDEX_STACK_SIZE, prio + 1, -2, false);
+}
+
+void execIndexStop() {
+
+    if (exec_index_thread) {
+        // the current file is finished first
+        exec_index_quit = true;
+        threadJoin(exec_index_thread, U64_MAX);
+        threadFree(exec_index_thread);
+        exec_index_thread = NULL;
+    }
+    free(exec_index_pending);
+    exec_index_pending = NULL;
+    exec_index_pending_count = 0;
+
+    if (exec_index_loaded) {
+        execIndexSave();
+    }
+}
+
+bool execIndexLookup(const char *path, executableMetadata_s *em) {
+
+    execIndexLoad();
+    u32 size, mtime;
+    return execIndexStat(path, &size, &mtime) && execIndexFresh(path, size, mtime, em);
+}
+
+void execIndexPut(const char *path, const executableMetadata_s *em) {
+
+    execIndexLoad();
+    u32 size, mtime;
+    if (em->scanned && execIndexStat(path, &size, &mtime)) {
+        execIndexStore(path, size, mtime, em);
+    }
+}
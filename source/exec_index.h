@@ -0,0 +1,46 @@
+#ifndef _exec_index_h_
+#define _exec_index_h_
+
+#include "scanner.h"
+
+// scan results of the 3dsx files on sd, so a launch doesn't scan anything
+#define EXEC_INDEX_PATH "/boot.3dsx"
+#define EXEC_INDEX_MAGIC 0x58444942 // 'BIDX'
+#define EXEC_INDEX_VERSION 2
+#define EXEC_INDEX_MAX 64           // executables kept, oldest replaced first
+#define EXEC_INDEX_PATH_MAX 128     // menuEntry_s.executablePath
+#define EXEC_INDEX_MTIME_RESOLUTION 2   // seconds, fat timestamps
+
+// an entry is valid while the file keeps its size and mtime, and its crc
+// when those can't tell (no mtime, or scanned within the mtime resolution)
+typedef struct {
+    u32 hash;
+    u32 size;
+    u32 mtime;
+    u32 writeTime;  // when the entry was stored, or last found unchanged
+    u32 crc;        // of the whole file, only set when the mtime is ambiguous
+    u32 sectionSizes[3];
+    u8 services[NUM_SERVICESTHATMATTER];
+    char path[EXEC_INDEX_PATH_MAX];
+} exec_index_entry_s;
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 next;       // slot replaced by the next new executable
+} exec_index_header_s;
+
+// index the boot entries, then "/" and "/3ds" in the background,
+// it only runs while the main thread waits (vblank)
+void execIndexStart();
+
+// stop the background indexing and write the index if it changed
+void execIndexStop();
+
+// metadata of path if it's indexed and unchanged, the file is only stat'ed
+bool execIndexLookup(const char *path, executableMetadata_s *em);
+
+// remember the scan of path
+void execIndexPut(const char *path, const executableMetadata_s *em);
+
+#endif // _exec_index_h_
@@ -5,6 +5,9 @@
 #include "scanner.h"
 #include "smdh.h"
 #include "netloader.h"
+#include "args.h"
+#include "process.h"
+#include "utility.h"
 
 extern FS_Archive sdmcArchive;
 
@@ -17,7 +20,7 @@ typedef struct {
 extern void (*__system_retAddr)(void);
 
 static Handle hbFileHandle;
-static u32 argbuffer[0x200];
+static u32 argbuffer[NETLOADER_CMDLINE_MAX / sizeof(u32)];
 static u32 argbuffer_length = 0;
 
 // ninjhax 1.x
@@ -30,12 +33,7 @@ static void launchFile_1x(void) {
     callBootloader_1x(0x00000000, hbFileHandle);
 }
 
-// ninjhax 2.0+
-typedef struct {
-    int processId;
-    bool capabilities[0x10];
-} processEntry_s;
-
+// ninjhax 2.0+ (processEntry_s is in process.h)
 void (*callBootloader_2x)(Handle file, u32 *argbuf, u32 arglength) = (void *) 0x00100000;
 
 void (*callBootloaderNewProcess_2x)(int processId, u32 *argbuf, u32 arglength) = (void *) 0x00100008;
@@ -66,43 +64,31 @@ bool isNinjhax2(void) {
     } else return true;
 }
 
-int bootApp(char *executablePath, executableMetadata_s *em, char *arg) {
+int bootApp(char *executablePath, executableMetadata_s *em, const char *args, size_t argsLen) {
+
+    // set argv/argc: the 3dsx, the boot entry arguments, then the 3dslink ones
+    args_s argv;
+    argsInit(&argv, argbuffer, sizeof(argbuffer));
+    char path[sizeof("sdmc:") + 512];
+    int len = snprintf(path, sizeof(path), "sdmc:%s", executablePath);
+    argsAdd(&argv, path, len < (int) sizeof(path) ? (size_t) len : sizeof(path) - 1);
+    if (args) {
+        argsAddList(&argv, args, argsLen);
+    }
+    if (netloader_boot && netloaded_commandline) {
+        argsAddList(&argv, netloaded_commandline, (size_t) netloaded_cmdlen);
+    }
+    if (argv.overflow) {
+        debug("Err: arguments don't fit in %i bytes\n", (int) sizeof(argbuffer));
+        return -1;
+    }
+    argbuffer_length = argsLength(&argv);
+
     // open file that we're going to boot up
     fsInit();
     FSUSER_OpenFileDirectly(&hbFileHandle, sdmcArchive, fsMakePath(PATH_ASCII, executablePath), FS_OPEN_READ, 0);
     fsExit();
 
-    // set argv/argc
-    argbuffer[0] = 0;
-    argbuffer_length = 0x200 * 4;
-
-    argbuffer[0] = 1;
-    snprintf((char *) &argbuffer[1], 0x200 * 4 - 4, "sdmc:%s", executablePath);
-
-    {
-        char *ptr = netloaded_commandline;
-        char *dst = (char *) &argbuffer[1];
-        dst += strlen(dst) + 1; // skip first argument
-
-        if (arg && *arg) {
-            strcpy(dst, arg);
-            dst += strlen(arg) + 1;
-            argbuffer[0]++;
-        }
-
-        if (netloader_boot) {
-            while (ptr < netloaded_commandline + netloaded_cmdlen) {
-                int n = strlen(ptr);
-                strcpy(dst, ptr);
-                ptr += n + 1;
-                dst += n + 1;
-                argbuffer[0]++;
-            }
-        }
-
-        argbuffer_length = (int) ((void *) dst - (void *) argbuffer);
-    }
-
     // figure out the preferred way of running the 3dsx
     if (!hbInit()) {
         // ninjhax 1.x !
@@ -111,7 +97,7 @@ int bootApp(char *executablePath, executableMetadata_s *em, char *arg) {
         hbExit();
 
         // set argv
-        setArgs_1x(argbuffer, 0x200 * 4);
+        setArgs_1x(argbuffer, sizeof(argbuffer));
 
         // override return address to homebrew booting code
         __system_retAddr = launchFile_1x;
@@ -121,38 +107,18 @@ int bootApp(char *executablePath, executableMetadata_s *em, char *arg) {
         __system_retAddr = launchFile_2x;
         if (em) {
             if (em->scanned && targetProcessId == -1) {
-                // this is a really shitty implementation of what we should be doing
-                // i'm really too lazy to do any better right now, but a good solution will come
-                // (some day)
-                processEntry_s out[4];
+                bool required[NUM_SERVICESTHATMATTER];
+                int i;
+                for (i = 0; i < NUM_SERVICESTHATMATTER; i++) {
+                    required[i] = em->servicesThatMatter[i] != 0;
+                }
+
+                processEntry_s out[8];
                 int out_len = 0;
-                getBestProcess_2x(em->sectionSizes, (bool *) em->servicesThatMatter, NUM_SERVICESTHATMATTER, out, 4,
-                                  &out_len);
-
-                // temp : check if we got all the services we want
-                if (em->servicesThatMatter[0] <= out[0].capabilities[0] &&
-                    em->servicesThatMatter[1] <= out[0].capabilities[1] &&
-                    em->servicesThatMatter[2] <= out[0].capabilities[2] &&
-                    em->servicesThatMatter[3] <= out[0].capabilities[3] &&
-                    em->servicesThatMatter[4] <= out[0].capabilities[4]) {
-                    targetProcessId = out[0].processId;
-                } else {
-                    // temp : if we didn't get everything we wanted, we search for the candidate that has as many highest-priority services as possible
-                    int i, j;
-                    int best_id = 0;
-                    int best_sum = 0;
-                    for (i = 0; i < out_len; i++) {
-                        int sum = 0;
-                        for (j = 0; j < NUM_SERVICESTHATMATTER; j++) {
-                            sum += (em->servicesThatMatter[j] == 1) && out[i].capabilities[j];
-                        }
-
-                        if (sum > best_sum) {
-                            best_id = i;
-                            best_sum = sum;
-                        }
-                    }
-                    targetProcessId = out[best_id].processId;
+                getBestProcess_2x(em->sectionSizes, required, NUM_SERVICESTHATMATTER, out, 8, &out_len);
+                int best = processSelect(out, out_len, em->servicesThatMatter, NUM_SERVICESTHATMATTER);
+                if (best >= 0) {
+                    targetProcessId = out[best].processId;
                 }
 
             } else if (targetProcessId != -1) targetProcessId = -2;
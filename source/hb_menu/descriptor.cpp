@@ -1,7 +1,7 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "descriptor.h"
-#include "tinyxml2.h"
-
-using namespace tinyxml2;
 
 void initDescriptor(descriptor_s *d) {
     if (!d)return;
@@ -14,101 +14,327 @@ void initDescriptor(descriptor_s *d) {
 
     d->selectTargetProcess = false;
     d->autodetectServices = true;
+    d->truncated = false;
+
+    arenaInit(&d->arena, 0x200);
 
     initMetadata(&d->executableMetadata);
 }
 
-// TODO : error checking
-void loadDescriptor(descriptor_s *d, char *path) {
-    if (!d || !path)return;
+// file buffers of loadDescriptor (main thread only), reset after each load
+// so repeated loads reuse the same block instead of going through the heap
+static arena_s descriptor_scratch = {NULL, DESCRIPTOR_SCRATCH_SIZE, 0, 0};
 
-    XMLDocument doc;
-    if (doc.LoadFile(path))return;
+// a piece of the descriptor file, not terminated
+typedef struct {
+    const char *str;
+    size_t len;
+} xml_view_s;
 
-    XMLElement *targets = doc.FirstChildElement("targets");
-    if (targets) {
-        // grab selectable target flag (default to false)
-        {
-            if (targets->QueryBoolAttribute("selectable", &d->selectTargetProcess)) d->selectTargetProcess = false;
-        }
+// single pass reader for the descriptor subset of xml: elements, attributes
+// and text, no dom, names and values are views into the file buffer
+typedef struct {
+    const char *p;
+    const char *end;
+} xml_reader_s;
 
-        // grab preferred target titles
-        {
-            d->numTargetTitles = 0;
-            for (tinyxml2::XMLElement *child = targets->FirstChildElement();
-                 child != NULL; child = child->NextSiblingElement()) {
-                if (!strcmp(child->Name(), "title")) {
-                    d->numTargetTitles++;
-                }
-            }
+enum {
+    XML_END,
+    XML_OPEN,       // <name, attributes follow
+    XML_CLOSE,      // </name> or the end of <name ... />
+    XML_TEXT
+};
 
-            d->targetTitles = (targetTitle_s *) malloc(sizeof(targetTitle_s) * d->numTargetTitles);
-            d->numTargetTitles = 0;
+static bool xmlIs(const xml_view_s *v, const char *str) {
+    return v->len == strlen(str) && !strncmp(v->str, str, v->len);
+}
 
-            for (tinyxml2::XMLElement *child = targets->FirstChildElement();
-                 child != NULL; child = child->NextSiblingElement()) {
-                if (!strcmp(child->Name(), "title")) {
-                    // SD is default mediatype
-                    int mediatype;
-                    if (child->QueryIntAttribute("mediatype", &mediatype))mediatype = 1;
+static bool xmlSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
 
-                    d->targetTitles[d->numTargetTitles].tid = strtoull(child->GetText(), NULL, 16);
-                    d->targetTitles[d->numTargetTitles].mediatype = mediatype;
+static void xmlSkipSpace(xml_reader_s *r) {
+    while (r->p < r->end && xmlSpace(*r->p)) r->p++;
+}
 
-                    d->numTargetTitles++;
-                }
+static const char *xmlFind(xml_reader_s *r, const char *str) {
+    size_t len = strlen(str);
+    const char *p = r->p;
+    for (; p + len <= r->end; p++) {
+        if (!memcmp(p, str, len)) return p;
+    }
+    return r->end;
+}
+
+static xml_view_s xmlName(xml_reader_s *r) {
+    xml_view_s name = {r->p, 0};
+    while (r->p < r->end && !xmlSpace(*r->p) && *r->p != '>' && *r->p != '/' && *r->p != '=') r->p++;
+    name.len = (size_t) (r->p - name.str);
+    return name;
+}
+
+// next attribute of the current start tag, false at its end
+static bool xmlAttribute(xml_reader_s *r, xml_view_s *name, xml_view_s *value, bool *empty) {
+    xmlSkipSpace(r);
+    if (r->p >= r->end) return false;
+    if (*r->p == '/' || *r->p == '>') {
+        *empty = *r->p == '/';
+        const char *close = (const char *) memchr(r->p, '>', (size_t) (r->end - r->p));
+        r->p = close ? close + 1 : r->end;
+        return false;
+    }
+
+    *name = xmlName(r);
+    xmlSkipSpace(r);
+    value->str = r->p;
+    value->len = 0;
+    if (r->p < r->end && *r->p == '=') {
+        r->p++;
+        xmlSkipSpace(r);
+        if (r->p < r->end && (*r->p == '"' || *r->p == '\'')) {
+            const char *close = (const char *) memchr(r->p + 1, *r->p, (size_t) (r->end - r->p - 1));
+            value->str = r->p + 1;
+            value->len = (size_t) ((close ? close : r->end) - value->str);
+            r->p = close ? close + 1 : r->end;
+        }
+    } else if (!name->len) {
+        r->p++; // stray character
+    }
+    return true;
+}
+
+static int xmlNext(xml_reader_s *r, xml_view_s *token) {
+
+    while (r->p < r->end) {
+        if (*r->p != '<') {
+            // text, trimmed
+            const char *lt = (const char *) memchr(r->p, '<', (size_t) (r->end - r->p));
+            const char *stop = lt ? lt : r->end;
+            xml_reader_s text = {r->p, stop};
+            xmlSkipSpace(&text);
+            while (stop > text.p && xmlSpace(stop[-1])) stop--;
+            r->p = lt ? lt : r->end;
+            if (stop > text.p) {
+                token->str = text.p;
+                token->len = (size_t) (stop - text.p);
+                return XML_TEXT;
             }
+            continue;
+        }
+
+        r->p++;
+        if (r->p < r->end && *r->p == '/') {
+            r->p++;
+            *token = xmlName(r);
+            const char *close = (const char *) memchr(r->p, '>', (size_t) (r->end - r->p));
+            r->p = close ? close + 1 : r->end;
+            return XML_CLOSE;
+        }
+        if (r->p < r->end && (*r->p == '?' || *r->p == '!')) {
+            // declaration, comment or doctype
+            const char *close = xmlFind(r, r->end - r->p >= 3 && !memcmp(r->p, "!--", 3) ? "-->" : ">");
+            r->p = close < r->end ? close + 1 : r->end;
+            continue;
         }
+        *token = xmlName(r);
+        return XML_OPEN;
+    }
+
+    return XML_END;
+}
+
+static bool xmlBool(const xml_view_s *v, bool *out) {
+    if (xmlIs(v, "true") || xmlIs(v, "1")) {
+        *out = true;
+    } else if (xmlIs(v, "false") || xmlIs(v, "0")) {
+        *out = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// the view as a c string, for strto*
+static void xmlCopy(const xml_view_s *v, char *out, size_t size) {
+    size_t len = v->len < size - 1 ? v->len : size - 1;
+    memcpy(out, v->str, len);
+    out[len] = '\0';
+}
+
+// the whole file with a single read through the fs service, no stdio copy
+static char *descriptorRead(const char *path, size_t *size) {
+
+    if (!strncmp(path, "sdmc:", 5)) {
+        path += 5;
+    }
+    Handle file;
+    FS_Archive sdmc = {0x00000009, {PATH_EMPTY, 1, (u8 *) ""}, 0};
+    if (FSUSER_OpenFileDirectly(&file, sdmc, fsMakePath(PATH_ASCII, path), FS_OPEN_READ, 0) != 0) {
+        return NULL;
     }
 
-    XMLElement *services = doc.FirstChildElement("services");
-    if (services) {
-        // grab "autodetect services" flag (default to true)
-        {
-            if (services->QueryBoolAttribute("autodetect", &d->autodetectServices)) d->autodetectServices = true;
+    u64 fileSize = 0;
+    u32 read = 0;
+    char *buf = NULL;
+    if (FSFILE_GetSize(file, &fileSize) == 0 && fileSize > 0 && fileSize <= DESCRIPTOR_FILE_MAX) {
+        buf = (char *) arenaAlloc(&descriptor_scratch, (size_t) fileSize);
+        if (buf && (FSFILE_Read(file, &read, 0, buf, (u32) fileSize) != 0 || read != fileSize)) {
+            buf = NULL;
         }
+    }
+    FSFILE_Close(file);
 
-        // grab requested services
-        {
-            d->numRequestedServices = 0;
-            for (tinyxml2::XMLElement *child = services->FirstChildElement();
-                 child != NULL; child = child->NextSiblingElement()) {
-                if (!strcmp(child->Name(), "request")) {
-                    d->numRequestedServices++;
-                }
-            }
+    *size = (size_t) fileSize;
+    return buf;
+}
 
-            d->requestedServices = (serviceRequest_s *) malloc(sizeof(serviceRequest_s) * d->numRequestedServices);
-            d->numRequestedServices = 0;
+void loadDescriptor(descriptor_s *d, char *path) {
+    if (!d || !path)return;
 
-            for (tinyxml2::XMLElement *child = services->FirstChildElement();
-                 child != NULL; child = child->NextSiblingElement()) {
-                if (!strcmp(child->Name(), "request")) {
-                    // 1 (highest) is default priority
-                    if (child->QueryIntAttribute("priority", &d->requestedServices[d->numRequestedServices].priority))
-                        d->requestedServices[d->numRequestedServices].priority = 1;
+    size_t size = 0;
+    char *buf = descriptorRead(path, &size);
+    if (buf) {
+        parseDescriptor(d, buf, size);
+    }
+    arenaReset(&descriptor_scratch);
+}
+
+void parseDescriptor(descriptor_s *d, const char *buf, size_t size) {
+    if (!d || !buf)return;
+
+    targetTitle_s titles[DESCRIPTOR_TITLES_MAX];
+    serviceRequest_s services[DESCRIPTOR_SERVICES_MAX];
+    u32 numTitles = 0, numServices = 0;
+
+    // <targets selectable=""><title mediatype="">tid</title></targets>
+    // <services autodetect=""><request priority="">name</request></services>
+    // only the first <targets> and <services> at the top level count
+    enum {
+        IN_NONE, IN_TARGETS, IN_SERVICES, IN_TITLE, IN_REQUEST, IN_OTHER
+    };
+    int stack[8];
+    int depth = 0, skipped = 0;
+    bool seenTargets = false, seenServices = false;
+    bool hasText = false;
+
+    xml_reader_s r = {buf, buf + size};
+    xml_view_s token, name, value;
+    int type;
+    while ((type = xmlNext(&r, &token)) != XML_END) {
+        int parent = depth > 0 ? stack[depth - 1] : IN_NONE;
+
+        if (type == XML_OPEN) {
+            int in = IN_OTHER;
+            if (depth == 0 && !seenTargets && xmlIs(&token, "targets")) {
+                in = IN_TARGETS;
+                seenTargets = true;
+                d->selectTargetProcess = false;
+            } else if (depth == 0 && !seenServices && xmlIs(&token, "services")) {
+                in = IN_SERVICES;
+                seenServices = true;
+                d->autodetectServices = true;
+            } else if (parent == IN_TARGETS && xmlIs(&token, "title") && numTitles == DESCRIPTOR_TITLES_MAX) {
+                d->truncated = true;
+            } else if (parent == IN_TARGETS && xmlIs(&token, "title")) {
+                in = IN_TITLE;
+                hasText = false;
+                // SD is default mediatype
+                titles[numTitles].tid = 0;
+                titles[numTitles].mediatype = 1;
+            } else if (parent == IN_SERVICES && xmlIs(&token, "request") && numServices == DESCRIPTOR_SERVICES_MAX) {
+                d->truncated = true;
+            } else if (parent == IN_SERVICES && xmlIs(&token, "request")) {
+                in = IN_REQUEST;
+                hasText = false;
+                // 1 (highest) is default priority
+                services[numServices].priority = 1;
+                services[numServices].name[0] = '\0';
+            }
 
-                    strncpy(d->requestedServices[d->numRequestedServices].name, child->GetText(), 9);
+            bool empty = false;
+            char num[24];
+            while (xmlAttribute(&r, &name, &value, &empty)) {
+                if (in == IN_TARGETS && xmlIs(&name, "selectable")) {
+                    xmlBool(&value, &d->selectTargetProcess);
+                } else if (in == IN_SERVICES && xmlIs(&name, "autodetect")) {
+                    xmlBool(&value, &d->autodetectServices);
+                } else if (in == IN_TITLE && xmlIs(&name, "mediatype")) {
+                    xmlCopy(&value, num, sizeof(num));
+                    titles[numTitles].mediatype = (u8) strtol(num, NULL, 10);
+                } else if (in == IN_REQUEST && xmlIs(&name, "priority")) {
+                    xmlCopy(&value, num, sizeof(num));
+                    // not a number: keep the default, as tinyxml2 did
+                    char *end;
+                    long priority = strtol(num, &end, 10);
+                    if (end != num) {
+                        services[numServices].priority = (int) priority;
+                    }
+                }
+            }
 
-                    d->numRequestedServices++;
+            // <title/> or <request/> have no text, they're dropped
+            if (!empty) {
+                if (depth < (int) (sizeof(stack) / sizeof(int))) {
+                    stack[depth++] = in;
+                } else {
+                    skipped++; // too deep for a descriptor
                 }
             }
+            continue;
+        }
+
+        if (type == XML_TEXT) {
+            if (parent == IN_TITLE) {
+                char tid[24];
+                xmlCopy(&token, tid, sizeof(tid));
+                titles[numTitles].tid = strtoull(tid, NULL, 16);
+                hasText = true;
+            } else if (parent == IN_REQUEST) {
+                xmlCopy(&token, services[numServices].name, sizeof(services[numServices].name));
+                hasText = true;
+            }
+            continue;
+        }
+
+        // XML_CLOSE
+        if (skipped > 0) {
+            skipped--;
+        } else if (depth > 0) {
+            int closed = stack[--depth];
+            if (closed == IN_TITLE && hasText) {
+                numTitles++;
+            } else if (closed == IN_REQUEST && hasText) {
+                numServices++;
+            }
         }
     }
+    setDescriptorLists(d, titles, numTitles, services, numServices);
 }
 
-void freeDescriptor(descriptor_s *d) {
-    if (!d)return;
+size_t descriptorHighWater() {
+    return arenaHighWater(&descriptor_scratch);
+}
 
-    if (d->targetTitles) {
-        free(d->targetTitles);
-        d->targetTitles = NULL;
-    }
+void setDescriptorLists(descriptor_s *d, const targetTitle_s *titles, u32 numTitles,
+                        const serviceRequest_s *services, u32 numServices) {
 
-    if (d->requestedServices) {
-        free(d->requestedServices);
-        d->requestedServices = NULL;
+    size_t titlesSize = sizeof(targetTitle_s) * numTitles;
+    size_t servicesSize = sizeof(serviceRequest_s) * numServices;
+    u8 *lists = titlesSize + servicesSize > 0 ? (u8 *) arenaAlloc(&d->arena, titlesSize + servicesSize) : NULL;
+    if (lists) {
+        d->targetTitles = (targetTitle_s *) lists;
+        memcpy(d->targetTitles, titles, titlesSize);
+        d->numTargetTitles = numTitles;
+        d->requestedServices = (serviceRequest_s *) (lists + titlesSize);
+        memcpy(d->requestedServices, services, servicesSize);
+        d->numRequestedServices = numServices;
     }
+}
+
+void freeDescriptor(descriptor_s *d) {
+    if (!d)return;
+
+    arenaFree(&d->arena);
 
     initDescriptor(d);
 }
@@ -8,6 +8,17 @@ extern "C" {
 #endif
 
 #include "scanner.h"
+#include "arena.h"
+
+// lists kept from one descriptor, the rest is ignored (descriptor_s.truncated)
+#define DESCRIPTOR_TITLES_MAX 32
+#define DESCRIPTOR_SERVICES_MAX 32
+
+// block of the loader's scratch arena, reused by every loadDescriptor,
+// descriptors are well below it
+#define DESCRIPTOR_SCRATCH_SIZE 0x1000
+// larger .xml files aren't descriptors, they're skipped
+#define DESCRIPTOR_FILE_MAX 0x10000
 
 typedef struct {
     u64 tid;
@@ -28,14 +39,28 @@ typedef struct {
 
     bool selectTargetProcess;
     bool autodetectServices;
+    bool truncated;     // titles or requests past the *_MAX above were dropped
 
     executableMetadata_s executableMetadata;
+
+    arena_s arena;  // targetTitles and requestedServices
 } descriptor_s;
 
 void initDescriptor(descriptor_s *d);
 void freeDescriptor(descriptor_s *d);
 void loadDescriptor(descriptor_s *d, char *path);
 
+// parse a descriptor in place: names and values are only views into buf,
+// nothing is copied but the final lists
+void parseDescriptor(descriptor_s *d, const char *buf, size_t size);
+
+// most scratch memory a loadDescriptor used
+size_t descriptorHighWater();
+
+// copy the lists into the descriptor arena, in a single allocation
+void setDescriptorLists(descriptor_s *d, const targetTitle_s *titles, u32 numTitles,
+                        const serviceRequest_s *services, u32 numServices);
+
 #ifdef __cplusplus
 }
 #endif
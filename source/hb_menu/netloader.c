@@ -180,7 +180,13 @@ int netloader_draw_error(void) {
     return 0;
 }
 
-int netloader_init(void) {
+// the socket service is only started when netloading,
+// normal boots never pay for the 1 MiB buffer or socInit
+int netloader_start(void) {
+    if (SOC_buffer != NULL) {
+        return 0;
+    }
+
     SOC_buffer = memalign(0x1000, 0x100000);
     if (SOC_buffer == NULL) {
         return -1;
@@ -276,7 +282,7 @@ int netloader_deactivate(void) {
 
     if (netloader_udpfd >= 0) {
         closesocket(netloader_udpfd);
-        netloader_datafd = -1;
+        netloader_udpfd = -1;
     }
 
     return 0;
@@ -342,9 +348,18 @@ int load3DSX(int sock, u32 remote) {
             send(sock, (int *) &response, sizeof(response), 0);
             //printf("\ntransferring command line\n");
             len = recvall(sock, (char *) &netloaded_cmdlen, 4, 0);
+            // it has to fit in the bootloader argument buffer anyway
+            if (len != 4 || netloaded_cmdlen < 0 || netloaded_cmdlen > NETLOADER_CMDLINE_MAX) {
+                netloaded_cmdlen = 0;
+            }
             if (netloaded_cmdlen) {
                 netloaded_commandline = malloc(netloaded_cmdlen);
-                len = recvall(sock, netloaded_commandline, netloaded_cmdlen, 0);
+                if (!netloaded_commandline
+                    || recvall(sock, netloaded_commandline, netloaded_cmdlen, 0) != netloaded_cmdlen) {
+                    free(netloaded_commandline);
+                    netloaded_commandline = NULL;
+                    netloaded_cmdlen = 0;
+                }
             }
         } else {
             response = 1;
@@ -403,8 +418,15 @@ int netloader_loop(void) {
     return 0;
 }
 
-int netloader_exit(void) {
+int netloader_stop(void) {
+    if (SOC_buffer == NULL) {
+        return 0;
+    }
+
+    netloader_deactivate();
     Result ret = socExit();
+    free(SOC_buffer);
+    SOC_buffer = NULL;
     if (ret != 0)
         return -1;
     return 0;
@@ -6,6 +6,8 @@
 #define CTRBOOTMANAGER_NETLOADER_H
 
 #define NETLOADER_PORT 17491
+// size of the bootloader argument buffer (see boot.c)
+#define NETLOADER_CMDLINE_MAX 0x800
 
 extern char *netloadedPath;
 extern char *netloaded_commandline;
@@ -16,11 +18,11 @@ int netloader_activate(void);
 
 int netloader_deactivate(void);
 
-int netloader_init(void);
+int netloader_start(void);
 
 int netloader_loop(void);
 
-int netloader_exit(void);
+int netloader_stop(void);
 
 int netloader_draw_error(void);
 
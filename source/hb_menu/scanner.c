@@ -1,10 +1,12 @@
 #include <3ds.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include "scanner.h"
 #include "utility.h"
-
-#define _3DSX_MAGIC 0x58534433 // '3DSX'
+#include "exec_index.h"
+#include "trace.h"
 
 typedef struct {
     u32 magic;
@@ -26,6 +28,144 @@ const char *servicesThatMatter[] =
                 "http:C"
         };
 
+// multi-pattern matcher (aho-corasick) compiled into a dfa: one table lookup per byte
+#define SCAN_STATES_MAX 64          // pattern lengths + 1
+#define SCAN_PATTERNS_MAX 16
+#define SCAN_COLON_WORD 0x3a3a3a3aU // "::::"
+
+typedef struct {
+    char **patterns;                // what the tables were built for
+    int count;
+    int before;                     // longest pattern part before its ':'
+    int after;                      // longest pattern part from its ':'
+    int longest;
+    bool colon;                     // every pattern has a ':', windows around them are enough
+    u16 out[SCAN_STATES_MAX];       // patterns ending in a state
+    u8 next[SCAN_STATES_MAX][256];
+} scan_automaton_s;
+
+static scan_automaton_s scan_ac;
+
+static bool scanBuild(char **patterns, int count) {
+
+    if (scan_ac.patterns == patterns && scan_ac.count == count) {
+        return true;
+    }
+    memset(&scan_ac, 0, sizeof(scan_automaton_s));
+    if (count > SCAN_PATTERNS_MAX) {
+        return false;
+    }
+
+    // trie, next[s][c] == 0 means no child yet
+    int states = 1;
+    int i;
+    scan_ac.colon = true;
+    for (i = 0; i < count; i++) {
+        const char *p = patterns[i];
+        const char *colon = strchr(p, ':');
+        int len = (int) strlen(p);
+        if (colon) {
+            int before = (int) (colon - p);
+            scan_ac.before = before > scan_ac.before ? before : scan_ac.before;
+            scan_ac.after = len - before > scan_ac.after ? len - before : scan_ac.after;
+        } else {
+            scan_ac.colon = false;
+        }
+        scan_ac.longest = len > scan_ac.longest ? len : scan_ac.longest;
+
+        int s = 0;
+        for (; *p; p++) {
+            u8 c = (u8) *p;
+            if (!scan_ac.next[s][c]) {
+                if (states == SCAN_STATES_MAX) {
+                    return false;
+                }
+                scan_ac.next[s][c] = (u8) states++;
+            }
+            s = scan_ac.next[s][c];
+        }
+        scan_ac.out[s] |= BIT(i);
+    }
+
+    // breadth first: failure links, then missing transitions follow them
+    u8 fail[SCAN_STATES_MAX] = {0};
+    u8 queue[SCAN_STATES_MAX];
+    int head = 0, tail = 0;
+    int c;
+    for (c = 0; c < 256; c++) {
+        if (scan_ac.next[0][c]) {
+            queue[tail++] = scan_ac.next[0][c];
+        }
+    }
+    while (head < tail) {
+        int s = queue[head++];
+        scan_ac.out[s] |= scan_ac.out[fail[s]];
+        for (c = 0; c < 256; c++) {
+            u8 t = scan_ac.next[s][c];
+            if (t) {
+                fail[t] = scan_ac.next[fail[s]][c];
+                queue[tail++] = t;
+            } else {
+                scan_ac.next[s][c] = scan_ac.next[fail[s]][c];
+            }
+        }
+    }
+
+    scan_ac.patterns = patterns;
+    scan_ac.count = count;
+    return true;
+}
+
+// run the dfa on buf[start..end) from state *s, returns the patterns found
+static u32 scanRun(const u8 *buf, size_t start, size_t end, int *s) {
+    u32 found = 0;
+    int state = *s;
+    size_t i;
+    for (i = start; i < end; i++) {
+        state = scan_ac.next[state][buf[i]];
+        found |= scan_ac.out[state];
+    }
+    *s = state;
+    return found;
+}
+
+static u32 scanBuffer(const u8 *buf, size_t len) {
+
+    int s = 0;
+    if (!scan_ac.colon) {
+        return scanRun(buf, 0, len, &s);
+    }
+
+    // service names all have a ':', rodata mostly doesn't: look for it
+    // a word at a time and only run the dfa around each one
+    u32 found = 0;
+    size_t i = 0, done = 0;
+    while (i < len) {
+        if (i + sizeof(uint32_t) <= len) {
+            uint32_t word;
+            memcpy(&word, buf + i, sizeof(uint32_t));
+            word ^= SCAN_COLON_WORD;
+            if (!((word - 0x01010101U) & ~word & 0x80808080U)) {
+                i += sizeof(uint32_t);
+                continue;
+            }
+        }
+        if (buf[i] == ':') {
+            size_t start = i > (size_t) scan_ac.before ? i - scan_ac.before : 0;
+            size_t end = i + scan_ac.after < len ? i + scan_ac.after : len;
+            // overlapping windows continue the previous run instead of rescanning
+            if (start > done) {
+                s = 0;
+                done = start;
+            }
+            found |= scanRun(buf, done, end, &s);
+            done = end;
+        }
+        i++;
+    }
+    return found;
+}
+
 void initMetadata(executableMetadata_s *em) {
     if (!em)return;
 
@@ -38,18 +178,48 @@ void initMetadata(executableMetadata_s *em) {
     memset(em->servicesThatMatter, 0x00, sizeof(em->servicesThatMatter));
 }
 
+static scan_stats_s scan_stats;
+
+const scan_stats_s *scanStats() {
+    return &scan_stats;
+}
+
+// bytes read by the last scan for the boot trace, in KiB (capped)
+static u8 scanStatsKiB() {
+    u32 kib = scan_stats.bytes / 1024;
+    return (u8) (kib > 0xFF ? 0xFF : kib);
+}
+
+// the file through the fs service directly, stdio would copy every block once more
+static Result scanOpen(const char *path, Handle *file) {
+    if (!strncmp(path, "sdmc:", 5)) {
+        path += 5;
+    }
+    FS_Archive sdmc = (FS_Archive) {0x00000009, (FS_Path) {PATH_EMPTY, 1, (u8 *) ""}, 0};
+    return FSUSER_OpenFileDirectly(file, sdmc, fsMakePath(PATH_ASCII, path), FS_OPEN_READ, 0);
+}
+
+static bool scanRead(Handle file, u64 offset, void *buf, u32 size) {
+    u32 read = 0;
+    Result ret = FSFILE_Read(file, &read, offset, buf, size);
+    scan_stats.bytes += read;
+    return ret == 0 && read == size;
+}
+
 Result scan3dsx(char *path, char **patterns, int num_patterns, u32 *sectionSizes, bool *patternsFound) {
     if (!path)return -1;
 
-    FILE *f = fopen(path, "rb");
-    if (!f)return -2;
+    u64 start = svcGetSystemTick();
+    scan_stats.bytes = 0;
+
+    Handle f;
+    if (scanOpen(path, &f) != 0)return -2;
 
     Result ret = 0;
+    u8 *buffer = NULL;
 
     _3DSX_Header hdr;
-    fread(&hdr, sizeof(_3DSX_Header), 1, f);
-
-    if (hdr.magic != _3DSX_MAGIC) {
+    if (!scanRead(f, 0, &hdr, sizeof(_3DSX_Header)) || hdr.magic != _3DSX_MAGIC) {
         ret = -3;
         goto end;
     }
@@ -61,51 +231,51 @@ Result scan3dsx(char *path, char **patterns, int num_patterns, u32 *sectionSizes
     }
 
     if (patterns && num_patterns && patternsFound) {
-        const int buffer_size = 0x1000;
         const int max_pattern_size = 0x10;
 
-        static u8 buffer[0x1000 + 0x10];
-
         int j;
         for (j = 0; j < num_patterns; j++)patternsFound[j] = false;
 
-        // only scan rodata
-        fseek(f, hdr.codeSegSize, SEEK_CUR);
-
-        int elements;
-        int total_scanned = 0;
-        do {
-            elements = fread(&buffer[max_pattern_size], 1, buffer_size, f);
-
-            int i, j;
-            int patternsCount[num_patterns];
-            for (j = 0; j < num_patterns; j++)patternsCount[j] = 0;
-            for (i = 0; i < elements + max_pattern_size; i++) {
-                const char v = buffer[i];
-                for (j = 0; j < num_patterns; j++) {
-                    if (!patternsFound[j]) {
-                        if (v == patterns[j][patternsCount[j]]) {
-                            patternsCount[j]++;
-                        } else if (v == patterns[j][0]) {
-                            patternsCount[j] = 1;
-                        } else {
-                            patternsCount[j] = 0;
-                        }
-
-                        if (patterns[j][patternsCount[j]] == 0x00) {
-                            patternsFound[j] = true;
-                        }
-                    }
-                }
+        buffer = malloc(SCAN_BLOCK_SIZE + max_pattern_size);
+        if (!buffer || !scanBuild(patterns, num_patterns) || scan_ac.longest > max_pattern_size) {
+            ret = -4;
+            goto end;
+        }
+
+        // only scan rodata: it follows the header, one relocation header
+        // per segment and the code segment
+        u64 offset = (u64) hdr.headerSize + 3 * (u64) hdr.relocHdrSize + hdr.codeSegSize;
+        u64 rodataEnd = offset + hdr.rodataSegSize;
+
+        // the tail of a block is scanned again with the next one,
+        // so a name split between two reads is still found
+        int carry = 0;
+        u32 found = 0;
+        u32 all = (u32) (BIT(num_patterns) - 1);
+        while (found != all && offset < rodataEnd) {
+            // up to the next block boundary, aligned reads after the first one
+            u32 size = SCAN_BLOCK_SIZE - (u32) (offset % SCAN_BLOCK_SIZE);
+            if (size > rodataEnd - offset) {
+                size = (u32) (rodataEnd - offset);
+            }
+            if (!scanRead(f, offset, &buffer[carry], size)) {
+                break;
             }
+            int len = carry + (int) size;
+            found |= scanBuffer(buffer, (size_t) len);
+
+            carry = len < scan_ac.longest - 1 ? len : scan_ac.longest - 1;
+            memmove(buffer, &buffer[len - carry], (size_t) carry);
+            offset += size;
+        }
 
-            memcpy(buffer, &buffer[buffer_size], max_pattern_size);
-            total_scanned += elements;
-        } while (elements == buffer_size && total_scanned < hdr.rodataSegSize);
+        for (j = 0; j < num_patterns; j++)patternsFound[j] = (found & BIT(j)) != 0;
     }
 
     end:
-    fclose(f);
+    free(buffer);
+    FSFILE_Close(f);
+    scan_stats.ticks = svcGetSystemTick() - start;
     return ret;
 }
 
@@ -127,15 +297,29 @@ void scanMenuEntry(menuEntry_s *me) {
     static char tmp[0x200];
     snprintf(tmp, 0x200, "sdmc:%s", me->executablePath);
 
+    // the index has the scan of known executables (see exec_index.c)
+    executableMetadata_s indexed;
+    bool known = execIndexLookup(me->executablePath, &indexed);
+
     if (me->descriptor.autodetectServices) {
         // if autodetection is enabled (default), we just scan the 3dsx for service names (not ideal but whatchagonnado)
-        scanExecutable(em, tmp);
+        if (known) {
+            *em = indexed;
+        } else {
+            scanExecutable(em, tmp);
+            execIndexPut(me->executablePath, em);
+            traceMarkArg(TRACE_SCAN, scanStatsKiB());
+        }
     } else {
         // if it's disabled, then we just populate the metadata structure with section sizes and requested services from descriptor
         int i, j;
-        scan3dsx(tmp, NULL, 0, em->sectionSizes, NULL);
+        if (known) {
+            memcpy(em->sectionSizes, indexed.sectionSizes, sizeof(em->sectionSizes));
+        } else {
+            scan3dsx(tmp, NULL, 0, em->sectionSizes, NULL);
+        }
 
-        for (i = 0; i < me->descriptor.numRequestedServices; i++) {
+        for (i = 0; i < (int) me->descriptor.numRequestedServices; i++) {
             for (j = 0; j < NUM_SERVICESTHATMATTER; j++) {
                 if (!strcmp(me->descriptor.requestedServices[i].name, servicesThatMatter[j])) {
                     em->servicesThatMatter[j] = me->descriptor.requestedServices[i].priority;
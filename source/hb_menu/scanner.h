@@ -3,14 +3,27 @@
 
 #define NUM_SERVICESTHATMATTER 5
 
+#define _3DSX_MAGIC 0x58534433 // '3DSX'
+
+// rodata is read in blocks of this size, aligned in the file
+#define SCAN_BLOCK_SIZE 0x10000
+
 typedef struct {
     bool scanned;
     u32 sectionSizes[3];
     u8 servicesThatMatter[NUM_SERVICESTHATMATTER];
 } executableMetadata_s;
 
+// i/o of the last scan3dsx call
+typedef struct {
+    u32 bytes;
+    u64 ticks;
+} scan_stats_s;
+
 void initMetadata(executableMetadata_s *em);
 
+const scan_stats_s *scanStats();
+
 Result scan3dsx(char *path, char **patterns, int num_patterns, u32 *sectionSizes, bool *patternsFound);
 
 void scanExecutable(executableMetadata_s *em, char *path);
@@ -1,34 +1,79 @@
 #include <3ds.h>
+#include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <assert.h>
 
 #include "brahma.h"
 #include "utility.h"
+#include "loader.h"
+#include "prefetch.h"
+#include "payload.h"
+#include "trace.h"
+#include "exec_index.h"
+#include "scanner.h"
 
 //These are global variables...
 char boot_app[512];
 bool boot_app_enabled;
+const char *boot_app_args;
+size_t boot_app_args_len;
 
 static_assert(sizeof(boot_app) == 512, "Size of the array has been changed!");
 
-int load_3dsx(char *path) {
+int load_3dsx(const char *path, const char *args, size_t argsLen) {
     memset(boot_app, 0, sizeof(boot_app));
     strncpy(boot_app, path, sizeof(boot_app));
+    boot_app_args = args;
+    boot_app_args_len = argsLen;
     boot_app_enabled = true;
     return 0;
 }
 
-int load_bin(char *path, long offset) {
+int load_bin(const char *path, const load_opts_s *opts) {
+
+    // the boot menu may have read the payload already,
+    // only a plain one: the prefetched bytes are not inflated nor patched
+    prefetchStop();
+    u32 size = 0;
+    u8 *data = NULL;
+    u8 *staged = NULL;
+    if (!opts->flags && !opts->patch) {
+        data = prefetchGet(path, opts->offset, &size);
+    }
+    if (!data) {
+        staged = malloc(LOAD_BIN_MAX_SIZE);
+        long len = staged ? payloadStage(path, opts->offset, opts->flags, opts->patch,
+                                         staged, LOAD_BIN_MAX_SIZE) : -1;
+        if (len <= 0) {
+            free(staged);
+            if (len == PAYLOAD_TOO_LARGE) {
+                debug("Err: arm9 payload larger than %i KiB...\n", LOAD_BIN_MAX_SIZE / 1024);
+            } else {
+                debug("Err: Couldn't read arm9 payload...\n");
+            }
+            return -1;
+        }
+        data = staged;
+        size = (u32) len;
+    }
+    traceMark(TRACE_PAYLOAD);
 
     if (brahma_init()) {
-        if (load_arm9_payload_offset(path, (u32) offset, 0x10000) != 1) {
+        s32 ret = load_arm9_payload_from_mem(data, size);
+        free(staged);
+        if (ret != 1) {
             debug("Err: Couldn't load arm9 payload...\n");
             return -1;
         }
+        traceEnd();
         firm_reboot();
         brahma_exit();
 
     } else {
+        free(staged);
         debug("Err: Couldn't init brahma...\n");
         return -1;
     }
@@ -36,23 +81,198 @@ int load_bin(char *path, long offset) {
     return 0;
 }
 
-int load(char *path, long offset) {
-    // check for reboot/poweroff
-    if (strcasecmp(path, "reboot") == 0) {
-        reboot();
-    } else if (strcasecmp(path, "shutdown") == 0) {
-        poweroff();
-    } else {
-        const char *ext = get_filename_ext(path);
-        if (strcasecmp(ext, "bin") == 0
-            || strcasecmp(ext, "dat") == 0) {
-            return load_bin(path, offset);
-        } else if (strcasecmp(ext, "3dsx") == 0) {
-            return load_3dsx(path);
-        } else {
-            debug("Invalid file: %s\n", path);
-            return -1;
+static int load_3dsx_entry(const char *path, const load_opts_s *opts) {
+    return load_3dsx(path, opts->args, opts->argsLen);
+}
+
+static int load_reboot(const char *path, const load_opts_s *opts) {
+    traceEnd();
+    reboot();
+    return 0;
+}
+
+static int load_poweroff(const char *path, const load_opts_s *opts) {
+    traceEnd();
+    poweroff();
+    return 0;
+}
+
+static const char *const bin_extensions[] = {"bin", "dat", NULL};
+static const char *const _3dsx_extensions[] = {"3dsx", NULL};
+
+// supported payloads, a new type only needs an entry here
+static const loader_s loaders[] = {
+        {"reboot",   NULL,              "reboot",   0,           0,               load_reboot},
+        {"shutdown", NULL,              "shutdown", 0,           0,               load_poweroff},
+        {"3dsx",     _3dsx_extensions,  NULL,       _3DSX_MAGIC, LOADER_ENTRY,    load_3dsx_entry},
+        {"arm9",     bin_extensions,    NULL,       0,           LOADER_PREFETCH | LOADER_INFLATE, load_bin},
+};
+
+#define LOADER_COUNT (sizeof(loaders) / sizeof(loader_s))
+#define LOADER_SLOTS 32 // power of two, well above the number of keys
+#define LOADER_EXT_MAX 8
+
+// magic paths and extensions, hashed case insensitively
+typedef struct {
+    const char *key;
+    const loader_s *loader;
+} loader_slot_s;
+
+static loader_slot_s loader_paths[LOADER_SLOTS];
+static loader_slot_s loader_exts[LOADER_SLOTS];
+static bool loader_init = false;
+
+static u32 loaderHash(const char *key) {
+    u32 hash = 2166136261U; // fnv-1a
+    while (*key) {
+        hash = (hash ^ (u8) tolower((u8) *key++)) * 16777619U;
+    }
+    return hash;
+}
+
+static void loaderInsert(loader_slot_s *slots, const char *key, const loader_s *loader) {
+    u32 i = loaderHash(key) & (LOADER_SLOTS - 1);
+    while (slots[i].key) {
+        i = (i + 1) & (LOADER_SLOTS - 1);
+    }
+    slots[i].key = key;
+    slots[i].loader = loader;
+}
+
+static const loader_s *loaderLookup(const loader_slot_s *slots, const char *key) {
+    u32 i = loaderHash(key) & (LOADER_SLOTS - 1);
+    while (slots[i].key) {
+        if (strcasecmp(slots[i].key, key) == 0) {
+            return slots[i].loader;
         }
+        i = (i + 1) & (LOADER_SLOTS - 1);
     }
-    return 0;
+    return NULL;
+}
+
+static void loaderInit() {
+
+    if (loader_init) {
+        return;
+    }
+
+    unsigned int i;
+    for (i = 0; i < LOADER_COUNT; i++) {
+        const loader_s *loader = &loaders[i];
+        if (loader->path) {
+            loaderInsert(loader_paths, loader->path, loader);
+        }
+        const char *const *ext;
+        for (ext = loader->extensions; ext && *ext; ext++) {
+            loaderInsert(loader_exts, *ext, loader);
+        }
+    }
+    loader_init = true;
+}
+
+// extension of name and the payload flags it implies: "ReiNand.bin.gz" is a compressed "bin"
+static const char *loaderExt(const char *name, char *buf, size_t size, u32 *flags) {
+
+    *flags = 0;
+    const char *ext = get_filename_ext(name);
+    if (strcasecmp(ext, "gz") != 0) {
+        return ext;
+    }
+
+    const char *end = ext - 1;
+    const char *start = end;
+    while (start > name && start[-1] != '.' && start[-1] != '/') {
+        start--;
+    }
+    if (start - 1 <= name || start[-1] != '.' || (size_t) (end - start) >= size) {
+        return "";
+    }
+    memcpy(buf, start, (size_t) (end - start));
+    buf[end - start] = '\0';
+    *flags = PAYLOAD_ZLIB;
+    return buf;
+}
+
+static u32 loaderFlags(const char *path) {
+    char buf[LOADER_EXT_MAX];
+    u32 flags;
+    loaderExt(path, buf, sizeof(buf), &flags);
+    return flags;
+}
+
+const loader_s *loaderForExt(const char *name) {
+    loaderInit();
+    char buf[LOADER_EXT_MAX];
+    u32 flags;
+    const char *ext = loaderExt(name, buf, sizeof(buf), &flags);
+    const loader_s *loader = *ext ? loaderLookup(loader_exts, ext) : NULL;
+    if (loader && flags & PAYLOAD_ZLIB && !(loader->flags & LOADER_INFLATE)) {
+        return NULL;
+    }
+    return loader;
+}
+
+const loader_s *loaderFind(const char *path) {
+
+    loaderInit();
+    const loader_s *loader = loaderLookup(loader_paths, path);
+    if (loader) {
+        return loader;
+    }
+
+    // the content wins over a wrong extension
+    FILE *file = fopen(path, "rb");
+    if (file != NULL) {
+        u32 magic = 0;
+        size_t read = fread(&magic, 1, sizeof(u32), file);
+        fclose(file);
+        unsigned int i;
+        for (i = 0; read == sizeof(u32) && i < LOADER_COUNT; i++) {
+            if (loaders[i].magic && loaders[i].magic == magic) {
+                return &loaders[i];
+            }
+        }
+    }
+
+    return loaderForExt(path);
+}
+
+int load_prefetch_start() {
+    return prefetchStart(LOAD_BIN_MAX_SIZE);
+}
+
+// start reading the payload of an entry that may be launched soon
+void load_prefetch(const boot_entry_s *entry) {
+    // compressed or patched payloads go through payloadStage at boot
+    if (entry->payload || entry->patch || loaderFlags(entry->path)) {
+        return;
+    }
+    const loader_s *loader = loaderForExt(entry->path);
+    if (loader && loader->flags & LOADER_PREFETCH) {
+        prefetchTarget(entry->path, entry->offset, LOAD_BIN_MAX_SIZE);
+    }
+}
+
+static int loadWith(const char *path, const load_opts_s *opts) {
+    // nothing reads the sd in the background past this point
+    execIndexStop();
+    const loader_s *loader = loaderFind(path);
+    if (!loader) {
+        debug("Invalid file: %s\n", path);
+        return -1;
+    }
+    // a picked "payload.bin.gz" or an entry without its compression setting
+    load_opts_s inflate = *opts;
+    inflate.flags |= loaderFlags(path);
+    return loader->load(path, &inflate);
+}
+
+int load(const char *path, long offset) {
+    load_opts_s opts = {offset, 0, NULL, NULL, 0};
+    return loadWith(path, &opts);
+}
+
+int loadEntry(const boot_entry_s *entry) {
+    load_opts_s opts = {entry->offset, entry->payload, entry->patch, entry->args, entry->argsLen};
+    return loadWith(entry->path, &opts);
 }
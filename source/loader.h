@@ -1,10 +1,57 @@
 #ifndef _loader_h_
 #define _loader_h_
 
-int load(char *path, long offset);
+#include "config.h"
 
-int load_3dsx(char *path);
+// arm9 payloads are read up to this size: brahma copies them to a fixed buffer
+// of ARM9_PAYLOAD_MAX_SIZE (64 KiB), anything larger can't be booted
+#define LOAD_BIN_MAX_SIZE 0x10000
 
-int load_bin(char *path, long offset);
+enum {
+    LOADER_PREFETCH = BIT(0),   // payload is worth reading ahead (see prefetch.c)
+    LOADER_ENTRY = BIT(1),      // can be added to the boot menu from the file picker
+    LOADER_INFLATE = BIT(2)     // reads compressed payloads ("payload.bin.gz")
+};
+
+// how a payload is read (see payload.h) and started
+typedef struct {
+    long offset;
+    u32 flags;              // PAYLOAD_*
+    const char *patch;      // ips patch applied after loading, NULL if none
+    const char *args;       // 3dsx arguments, '\0' separated, NULL if none
+    size_t argsLen;
+} load_opts_s;
+
+// one payload type: dispatched by magic path, magic bytes or extension
+typedef struct {
+    const char *name;
+    const char *const *extensions;  // NULL terminated, NULL if none
+    const char *path;               // magic path ("reboot"), NULL for files
+    u32 magic;                      // first 4 bytes of the file, 0 if none
+    u32 flags;
+    int (*load)(const char *path, const load_opts_s *opts);
+} loader_s;
+
+// loader for path: magic path, then a sniff of the file, then its extension
+const loader_s *loaderFind(const char *path);
+
+// loader for a file name, by extension only (no file access),
+// a ".gz" suffix is looked through to the extension before it
+const loader_s *loaderForExt(const char *name);
+
+int load(const char *path, long offset);
+
+// load a boot entry with its compression and patch settings
+int loadEntry(const boot_entry_s *entry);
+
+// start the background reader used by load_prefetch
+int load_prefetch_start();
+
+void load_prefetch(const boot_entry_s *entry);
+
+// args: '\0' separated list passed to the 3dsx after its path
+int load_3dsx(const char *path, const char *args, size_t argsLen);
+
+int load_bin(const char *path, const load_opts_s *opts);
 
 #endif // _loader_h_
@@ -5,53 +5,72 @@
 
 #include "hb_menu/netloader.h"
 #include "config.h"
+#include "config_keys.h"
 #include "scanner.h"
 #include "utility.h"
 #include "menu.h"
+#include "ready.h"
+#include "prefetch.h"
+#include "trace.h"
+#include "service.h"
+#include "exec_index.h"
+#include "descriptor_cache.h"
 
 extern char boot_app[512];
 extern bool boot_app_enabled;
+extern const char *boot_app_args;
+extern size_t boot_app_args_len;
+extern bool timer;
+
+typedef enum {
+    BOOT_STATE_CONFIG,      // load boot.cfg (or its cache)
+    BOOT_STATE_AUTOBOOT,    // timeout = 0, boot without showing the menu
+    BOOT_STATE_MENU,        // boot menu
+    BOOT_STATE_RECOVERY,    // no usable config, "More..." menu only
+    BOOT_STATE_LAUNCH,      // a 3dsx was selected, hand it to the bootloader
+    BOOT_STATE_EXIT         // nothing left to launch (payload rebooted, app closed)
+} boot_state_e;
 
 extern void scanMenuEntry(menuEntry_s *me);
 
-int bootApp(char *executablePath, executableMetadata_s *em, char *arg);
+int bootApp(char *executablePath, executableMetadata_s *em, const char *args, size_t argsLen);
 
 void __appInit() {
-    srvInit();
-    aptInit();
-    fsInit();
-    sdmcInit();
-    openSDArchive();
-    hidInit();
-    acInit();
-    ptmuInit();
-    amInit();
+    traceStart();
+    serviceWait(SERVICE_APT);
+    // what every boot path needs comes up while gfx is initialized,
+    // the others are only started by the paths using them (serviceWait)
+    serviceStart(SERVICE_SDMC | SERVICE_HID);
     gfxInitDefault();
     gfxSet3D(false);
+    traceMark(TRACE_APP_INIT);
 }
 
 void __appExit() {
+    // nothing was launched, still log the boot while the sd is up
+    traceEnd();
+    execIndexStop();
     gfxExit();
-    netloader_exit();
+    prefetchExit();
+    netloader_stop();
     configExit();
-    amExit();
-    ptmuExit();
-    acExit();
-    hidExit();
-    closeSDArchive();
-    sdmcExit();
-    fsExit();
-    aptExit();
-    srvExit();
+    serviceExit();
 }
 
-int main(int argc, char *argv[]) {
+// state to go to once an entry was successfully loaded
+static boot_state_e bootLoaded() {
+    return boot_app_enabled ? BOOT_STATE_LAUNCH : BOOT_STATE_EXIT;
+}
 
-    if (netloader_init() != 0) {
-        // fix SOC_Initialize
-        strcpy(boot_app, "/boot.3dsx");
-        boot_app_enabled = true;
+static boot_state_e bootMenu(int (*menu)()) {
+    while (aptMainLoop()) {
+        if (menu() == 0)
+            return bootLoaded();
     }
+    return BOOT_STATE_EXIT;
+}
+
+int main(int argc, char *argv[]) {
 
     osSetSpeedupEnable(true);
 
@@ -60,34 +79,78 @@ int main(int argc, char *argv[]) {
     APT_SetAppCpuTimeLimit(0); //According to http://3dbrew.org/APT:SetApplicationCpuTimeLimit, this is oh so wrong...
     aptCloseSession();
 
-    if (!boot_app_enabled) { // fix SOC_Initialize
-
-        if (configInit() != 0 || config->count <= 0) { // recovery
-            while (aptMainLoop()) {
-                if (menu_more() == 0)
-                    break;
-            }
-        } else {
-            while (aptMainLoop()) {
-                if (menu_boot() == 0)
-                    break;
-            }
+    boot_state_e state = BOOT_STATE_CONFIG;
+    int boot_override = -1;
+    bool recovery = false;
+    while (state != BOOT_STATE_LAUNCH && state != BOOT_STATE_EXIT) {
+        switch (state) {
+            case BOOT_STATE_CONFIG:
+                // hid is polled by the menus as well, recovery included
+                serviceWait(SERVICE_SDMC | SERVICE_HID);
+                if (configInit() == 0) {
+                    traceMark(TRACE_CONFIG);
+                    traceEnable(config->trace != 0);
+                    // the only input sample taken for the boot keys:
+                    // picks the profile and the entry to boot, if any
+                    readyWait(READY_HID, READY_FRAMES_MS(config->autobootfix));
+                    hidScanInput();
+                    u32 held = hidKeysHeld();
+                    boot_override = configResolveKeys(held);
+                    traceMark(TRACE_KEYS);
+                    recovery = (held & BIT(config->recovery)) != 0;
+                    if (recovery) {
+                        timer = false; // disable autoboot
+                    }
+                }
+                if (config == NULL) {
+                    // not even the empty recovery profile could be allocated
+                    state = BOOT_STATE_EXIT;
+                } else if (config->count <= 0) {
+                    state = BOOT_STATE_RECOVERY;
+                } else if (!recovery && (boot_override >= 0 || config->timeout == 0)) {
+                    state = BOOT_STATE_AUTOBOOT;
+                } else {
+                    state = BOOT_STATE_MENU;
+                }
+                break;
+
+            case BOOT_STATE_AUTOBOOT:
+                // sockets and theme are only brought up if we end in the menu
+                state = menu_autoboot(boot_override >= 0 ? boot_override : config->index) == 0
+                        ? bootLoaded() : BOOT_STATE_MENU;
+                break;
+
+            case BOOT_STATE_MENU:
+                state = bootMenu(menu_boot);
+                break;
+
+            case BOOT_STATE_RECOVERY:
+                state = bootMenu(menu_more);
+                break;
+
+            default:
+                state = BOOT_STATE_EXIT;
+                break;
         }
     }
 
+    if (state != BOOT_STATE_LAUNCH) {
+        return 0;
+    }
+
     menuEntry_s *me = malloc(sizeof(menuEntry_s));
     strncpy(me->executablePath, boot_app, 128);
     initDescriptor(&me->descriptor);
-    static char xmlPath[128];
-    snprintf(xmlPath, 128, "%s", boot_app);
-    int l = strlen(xmlPath);
-    xmlPath[l - 1] = 0;
-    xmlPath[l - 2] = 'l';
-    xmlPath[l - 3] = 'm';
-    xmlPath[l - 4] = 'x';
-    if (fileExists(xmlPath))
-        loadDescriptor(&me->descriptor, xmlPath);
+    descriptorCacheLoad(&me->descriptor, boot_app);
+    // the background indexing shares the scanner
+    execIndexStop();
     scanMenuEntry(me);
+    size_t scratch = descriptorHighWater() / 64;
+    traceMarkArg(TRACE_DESCRIPTOR, (u8) (scratch < 0xFF ? scratch : 0xFF));
+    traceEnd();
+
+    // bootApp opens the 3dsx through the raw archive
+    serviceWait(SERVICE_SD_ARCHIVE);
 
-    return bootApp(me->executablePath, &me->descriptor.executableMetadata, me->arg);
+    return bootApp(me->executablePath, &me->descriptor.executableMetadata, boot_app_args, boot_app_args_len);
 }
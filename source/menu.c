@@ -12,6 +12,8 @@
 
 void drawBg() {
 
+    configInitTheme();
+
     if (!config->imgError) {
         memcpy(gfxGetFramebuffer(GFX_TOP, GFX_LEFT, NULL, NULL), config->bgImgTopBuff,
                (size_t) config->bgImgTopSize);
@@ -20,6 +20,8 @@ int menu_more();
 
 int menu_boot();
 
+int menu_autoboot(int index);
+
 int menu_config();
 
 int menu_netloader();
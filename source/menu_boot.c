@@ -6,32 +6,36 @@
 #include "loader.h"
 #include "menu.h"
 #include "utility.h"
+#include "verify.h"
+#include "ready.h"
+#include "trace.h"
+#include "exec_index.h"
+
+#define MAX_LINE 11
 
 bool timer = true;
 
 
 int autoBootFix(int index) {
 
-    int delay = config->autobootfix;
-    while (aptMainLoop() && delay > 0) {
-        gfxSwap();
-        delay--;
-    }
+    // boot keys were already resolved at power-on (configResolveKeys),
+    // wait for what the handover depends on, autobootfix is only the upper bound
+    readyWait(READY_ALL, READY_FRAMES_MS(config->autobootfix));
 
-    hidScanInput();
-    u32 k = hidKeysHeld();
-    if (k) {
-        int i = 0;
-        for (i = 0; i < config->count; i++) {
-            if (k & BIT(config->entries[i].key)) {
-                index = i;
-                break;
-            }
-        }
+    return loadEntry(&config->entries[index]);
+}
+
+// autoboot fast path (timeout = 0 or a boot key held), only needs the resolved config:
+// nothing is drawn and no theme resource is loaded unless it fails
+int menu_autoboot(int index) {
+
+    if (autoBootFix(index) == 0) {
+        return 0;
     }
 
-    return load(config->entries[index].path,
-                config->entries[index].offset);
+    // don't retry, fall back to the boot menu
+    timer = false;
+    return -1;
 }
 
 int menu_boot() {
@@ -40,13 +44,19 @@ int menu_boot() {
     int boot_index = config->index;
     int i = 0;
 
+    // timeout = 0 never gets here, main goes to menu_autoboot instead
     hidScanInput();
     if (config->timeout < 0 || hidKeysHeld() & BIT(config->recovery)) { // disable autoboot
         timer = false;
-    } else if (config->timeout == 0) { // autoboot
-        return autoBootFix(boot_index);
     }
 
+    traceMark(TRACE_MENU);
+
+    // read the highlighted payload while counting down
+    load_prefetch_start();
+    // index the 3dsx files while the menu waits for input
+    execIndexStart();
+
     time(&start);
 
     while (aptMainLoop()) {
@@ -58,7 +68,13 @@ int menu_boot() {
             elapsed = end - start;
             if (elapsed >= config->timeout
                 && config->count > boot_index) {
-                return autoBootFix(boot_index);
+                // a payload known to be bad is never booted unattended,
+                // an unfinished check doesn't hold the boot back
+                if (config->entries[boot_index].verify < VERIFY_MISSING) {
+                    verifyStop();
+                    return autoBootFix(boot_index);
+                }
+                timer = false;
             }
         }
 
@@ -76,15 +92,27 @@ int menu_boot() {
                 boot_index = config->count;
         }
 
+        // switch profile
+        if (kDown & (KEY_L | KEY_R) && profileCount > 1) {
+            timer = false;
+            verifyStop();
+            int profile = (int) (config - profiles) + (kDown & KEY_R ? 1 : -1);
+            configSelectProfile((profile + profileCount) % profileCount);
+            boot_index = config->index;
+        }
+
         if (kDown & KEY_A) {
             timer = false;
+            verifyStop();
             if (boot_index == config->count) {
                 if (menu_more() == 0) {
                     break;
                 }
             } else {
-                if (load(config->entries[boot_index].path,
-                         config->entries[boot_index].offset) == 0) {
+                boot_entry_s *entry = &config->entries[boot_index];
+                if ((entry->verify < VERIFY_MISSING
+                     || confirm(0, "Payload check %s:\n%s\n\nBoot it anyway ?\n", verifyStatus(entry), entry->path))
+                    && loadEntry(entry) == 0) {
                     break;
                 }
             }
@@ -92,36 +120,67 @@ int menu_boot() {
 
         if (kDown & KEY_X) {
             timer = false;
+            verifyStop();
             if (boot_index != config->count) {
                 if (confirm(3, "Delete boot entry: \"%s\" ?\n", config->entries[boot_index].title)) {
                     configRemoveEntry(boot_index);
-                    boot_index--;
+                    if (boot_index > 0)
+                        boot_index--;
                 }
             }
         }
 
+        // check and read the highlighted payload while the menu is shown
+        if (boot_index < config->count) {
+            verifyStart(&config->entries[boot_index]);
+            load_prefetch(&config->entries[boot_index]);
+        }
+        verifyStep();
+
         drawBg();
-        if (!timer) {
+        if (!timer && profileCount > 1) {
+            drawTitle("*** Select a boot entry (%s) ***", config->name);
+        } else if (!timer) {
             drawTitle("*** Select a boot entry ***");
         } else {
             drawTitle("*** Booting %s in %i ***", config->entries[boot_index].title, config->timeout - elapsed);
         }
 
-        for (i = 0; i < config->count; i++) {
-            drawItem(i == boot_index, 16 * i, config->entries[i].title);
+        // entries + "More...", one page at a time
+        int y = 0;
+        int page = boot_index / MAX_LINE;
+        for (i = page * MAX_LINE; i < page * MAX_LINE + MAX_LINE; i++) {
+            if (i > config->count)
+                break;
+
+            if (i == config->count) {
+                drawItem(i == boot_index, 16 * y, "More...");
+                if (i == boot_index) {
+                    drawInfo("Show more options ...");
+                }
+                break;
+            }
+
+            boot_entry_s *entry = &config->entries[i];
+            drawItem(i == boot_index, 16 * y, entry->title);
             if (i == boot_index) {
-                drawInfo("Name: %s\nPath: %s\nOffset: 0x%lx\n\n\nPress (A) to launch\nPress (X) to remove entry\n",
-                         config->entries[i].title,
-                         config->entries[i].path,
-                         config->entries[i].offset);
+                char keys[64] = "none";
+                if (entry->keys) {
+                    get_buttons(entry->keys, keys, sizeof(keys));
+                }
+                drawInfo("Name: %s\nPath: %s\nOffset: 0x%lx\nKey: %s%s\nCheck: %s\n\nPress (A) to launch\nPress (X) to remove entry\n",
+                         entry->title,
+                         entry->path,
+                         entry->offset,
+                         keys,
+                         entry->keyConflict ? " (already bound, ignored)" : "",
+                         verifyStatus(entry));
             }
-        }
-        drawItem(boot_index == config->count, 16 * i, "More...");
-        if (boot_index == config->count) {
-            drawInfo("Show more options ...");
+            y++;
         }
 
         gfxSwap();
     }
+    verifyStop();
     return 0;
 }
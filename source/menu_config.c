@@ -2,63 +2,26 @@
 #include <time.h>
 
 #include "config.h"
+#include "config_schema.h"
 #include "gfx.h"
 #include "utility.h"
 #include "menu.h"
 
-void keyLeft(int index) {
+// settings shown in the menu, in schema order
+static int menu_settings[CONFIG_SCHEMA_COUNT];
 
-    switch (index) {
-        case 0:
-            if (config->timeout > -1)
-                config->timeout--;
-            break;
-        case 1:
-            if (config->index > 0)
-                config->index--;
-            else
-                config->index = config->count - 1;
-            break;
-        case 2:
-            if (config->autobootfix > 0)
-                config->autobootfix--;
-            break;
-        case 3:
-            if (config->recovery > 0)
-                config->recovery--;
-            else
-                config->recovery = 11;
-            break;
-    }
-}
-
-void keyRight(int index) {
-
-    switch (index) {
-        case 0:
-            config->timeout++;
-            break;
-        case 1:
-            if (config->index < config->count - 1)
-                config->index++;
-            else
-                config->index = 0;
-            break;
-        case 2:
-            config->autobootfix++;
-            break;
-        case 3:
-            if (config->recovery < 11)
-                config->recovery++;
-            else
-                config->recovery = 0;
-            break;
-    }
+static void keyStep(int index, int step) {
+    configSchemaStep(config, &config_schema[menu_settings[index]], step);
 }
 
 int menu_config() {
 
-    int menu_count = 4, menu_index = 0;
+    int i, menu_count = 0, menu_index = 0;
+    for (i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        if (config_schema[i].flags & CONFIG_SCHEMA_MENU) {
+            menu_settings[menu_count++] = i;
+        }
+    }
     // key repeat timer
     time_t t_start = 0, t_end = 0, t_elapsed = 0;
 
@@ -84,25 +47,25 @@ int menu_config() {
         }
 
         if (kDown & KEY_LEFT) {
-            keyLeft(menu_index);
+            keyStep(menu_index, -1);
             time(&t_start);
         } else if (kHeld & KEY_LEFT) {
             time(&t_end);
             t_elapsed = t_end - t_start;
             if (t_elapsed > 0) {
-                keyLeft(menu_index);
+                keyStep(menu_index, -1);
                 svcSleep(100);
             }
         }
 
         if (kDown & KEY_RIGHT) {
-            keyRight(menu_index);
+            keyStep(menu_index, 1);
             time(&t_start);
         } else if (kHeld & KEY_RIGHT) {
             time(&t_end);
             t_elapsed = t_end - t_start;
             if (t_elapsed > 0) {
-                keyRight(menu_index);
+                keyStep(menu_index, 1);
                 svcSleep(100);
             }
         }
@@ -115,10 +78,22 @@ int menu_config() {
         drawBg();
         drawTitle("*** Boot configuration ***");
 
-        drawItem(menu_index == 0, 0, "Timeout:  %i", config->timeout);
-        drawItem(menu_index == 1, 16, "Default:  %s", config->entries[config->index].title);
-        drawItem(menu_index == 2, 32, "Bootfix:  %i", config->autobootfix);
-        drawItem(menu_index == 3, 48, "Recovery key:  %s", get_button(config->recovery));
+        for (i = 0; i < menu_count; i++) {
+            const config_schema_s *s = &config_schema[menu_settings[i]];
+            int value = *configSchemaInt(config, s);
+            switch (s->type) {
+                case CONFIG_SCHEMA_ENTRY:
+                    drawItem(menu_index == i, 16 * i, "%s:  %s", s->label,
+                             value < config->count ? config->entries[value].title : "-");
+                    break;
+                case CONFIG_SCHEMA_BUTTON:
+                    drawItem(menu_index == i, 16 * i, "%s:  %s", s->label, get_button(value));
+                    break;
+                default:
+                    drawItem(menu_index == i, 16 * i, "%s:  %i", s->label, value);
+                    break;
+            }
+        }
 
         gfxSwap();
     }
@@ -8,13 +8,21 @@
 #include "loader.h"
 #include "config.h"
 #include "menu.h"
+#include "trace.h"
 
 int menu_netloader() {
 
+    if (netloader_start() != 0) {
+        debug("Err: netloader_start");
+        return -1;
+    }
+
     if (netloader_activate() != 0) {
         debug("Err: netloader_activate");
+        netloader_stop();
         return -1;
     }
+    traceMark(TRACE_NETLOADER);
 
     char msg[256];
     u32 ip = (u32) gethostid();
@@ -34,18 +42,20 @@ int menu_netloader() {
         u32 kDown = hidKeysDown();
 
         if (kDown & KEY_B) {
-            netloader_deactivate();
-            return -1;
+            break;
         }
 
         int rc = netloader_loop();
         if (rc > 0) {
+            netloader_stop();
             netloader_boot = true;
-            return load_3dsx(netloadedPath);
+            return load_3dsx(netloadedPath, NULL, 0);
         } else if (rc < 0) {
             netloader_draw_error();
             break;
         }
     }
+
+    netloader_stop();
     return -1;
 }
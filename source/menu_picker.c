@@ -10,6 +10,7 @@
 #include "utility.h"
 #include "config.h"
 #include "menu.h"
+#include "loader.h"
 
 #define MAX_LINE 11
 
@@ -43,13 +44,8 @@ void get_dir(const char *path) {
     while ((file = readdir(fd))) {
         if (!strcmp(file->d_name, ".") || !strcmp(file->d_name, ".."))
             continue;
-        if (file->d_type != DT_DIR) {
-            const char *ext = get_filename_ext(file->d_name);
-            if (strcasecmp(ext, "bin") != 0
-                && strcasecmp(ext, "dat") != 0
-                && strcasecmp(ext, "3dsx") != 0)
-                continue;
-        }
+        if (file->d_type != DT_DIR && !loaderForExt(file->d_name))
+            continue;
 
         // file name
         strncpy(picker->files[picker->file_count].name, file->d_name, 512);
@@ -153,12 +149,10 @@ void pick_file(file_s *picked, const char *path) {
         } else if (kDown & KEY_X) {
             int index = picker->file_index;
             if (!picker->files[index].isDir) {
-                const char *ext = get_filename_ext(picker->files[index].name);
-                if (strcasecmp(ext, "3dsx") == 0) {
+                const loader_s *loader = loaderFind(picker->files[index].path);
+                if (loader && loader->flags & LOADER_ENTRY) {
                     if (confirm(3, "Add entry to boot menu: \"%s\" ?", picker->files[index].name)) {
-                        if (config->count > CONFIG_MAX_ENTRIES - 1) {
-                            debug("Maximum entries reached (%i)\n", CONFIG_MAX_ENTRIES);
-                        } else if (configAddEntry(picker->files[index].name, picker->files[index].path, 0) == 0) {
+                        if (configAddEntry(picker->files[index].name, picker->files[index].path, 0) == 0) {
                             debug("Added entry: %s\n", picker->files[index].name);
                         } else {
                             debug("Error adding entry: %s\n", picker->files[index].name);
@@ -0,0 +1,257 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "payload.h"
+
+static int stagingWrite(payload_stage_s *stage, const u8 *data, size_t size) {
+    payload_staging_s *staging = (payload_staging_s *) stage;
+    if (size > staging->max - staging->size) {
+        staging->overflow = true; // doesn't fit in the staging buffer
+        return -1;
+    }
+    memcpy(staging->buf + staging->size, data, size);
+    staging->size += size;
+    return 0;
+}
+
+// nothing buffered, the last write already made it to the buffer
+static int stagingFinish(payload_stage_s *stage) {
+    (void) stage;
+    return 0;
+}
+
+void payloadStagingInit(payload_staging_s *staging, u8 *buf, size_t max) {
+    staging->stage.write = stagingWrite;
+    staging->stage.finish = stagingFinish;
+    staging->stage.next = NULL;
+    staging->buf = buf;
+    staging->size = 0;
+    staging->max = max;
+    staging->overflow = false;
+}
+
+static int inflateWrite(payload_stage_s *stage, const u8 *data, size_t size) {
+
+    payload_inflate_s *inflate_stage = (payload_inflate_s *) stage;
+    z_stream *z = &inflate_stage->z;
+    if (inflate_stage->done) {
+        return 0; // trailing data after the stream
+    }
+
+    z->next_in = (Bytef *) data;
+    z->avail_in = (uInt) size;
+    while (z->avail_in > 0) {
+        z->next_out = inflate_stage->out;
+        z->avail_out = sizeof(inflate_stage->out);
+        int ret = inflate(z, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END) {
+            return -1;
+        }
+        size_t produced = sizeof(inflate_stage->out) - z->avail_out;
+        if (produced > 0 && stage->next->write(stage->next, inflate_stage->out, produced) != 0) {
+            return -1;
+        }
+        if (ret == Z_STREAM_END) {
+            inflate_stage->done = true;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static int inflateFinish(payload_stage_s *stage) {
+    payload_inflate_s *inflate_stage = (payload_inflate_s *) stage;
+    if (!inflate_stage->done) {
+        return -1; // truncated stream
+    }
+    return stage->next->finish(stage->next);
+}
+
+int payloadInflateInit(payload_inflate_s *inflate_stage, payload_stage_s *next) {
+    memset(&inflate_stage->z, 0, sizeof(z_stream));
+    inflate_stage->stage.write = inflateWrite;
+    inflate_stage->stage.finish = inflateFinish;
+    inflate_stage->stage.next = next;
+    inflate_stage->done = false;
+    // 15 + 32: zlib or gzip header, detected automatically
+    return inflateInit2(&inflate_stage->z, 15 + 32) == Z_OK ? 0 : -1;
+}
+
+void payloadInflateEnd(payload_inflate_s *inflate_stage) {
+    inflateEnd(&inflate_stage->z);
+}
+
+int payloadRead(const char *path, long offset, size_t max, payload_stage_s *first) {
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    // our reads are big enough, don't copy through the stdio buffer
+    setvbuf(file, NULL, _IONBF, 0);
+    if (fseek(file, offset, SEEK_SET) != 0) {
+        fclose(file);
+        return -1;
+    }
+
+    u8 *buf = malloc(PAYLOAD_CHUNK);
+    if (!buf) {
+        fclose(file);
+        return -1;
+    }
+
+    // first read up to the next chunk boundary, the next ones are aligned
+    size_t len = PAYLOAD_CHUNK - (size_t) offset % PAYLOAD_CHUNK;
+    size_t total = 0;
+    int ret = 0;
+    while (total < max) {
+        if (len > max - total) {
+            len = max - total;
+        }
+        size_t read = fread(buf, 1, len, file);
+        if (read > 0 && first->write(first, buf, read) != 0) {
+            ret = -1;
+            break;
+        }
+        total += read;
+        if (read < len) {
+            if (ferror(file)) {
+                ret = -1;
+            }
+            break;
+        }
+        len = PAYLOAD_CHUNK;
+    }
+
+    free(buf);
+    fclose(file);
+
+    if (ret == 0) {
+        ret = first->finish(first);
+    }
+    return ret;
+}
+
+static u32 ipsRead(const u8 *p, int len) {
+    u32 v = 0;
+    while (len--) {
+        v = v << 8 | *p++;
+    }
+    return v;
+}
+
+int payloadPatch(payload_staging_s *staging, const char *path) {
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    u8 *ips = size > 0 ? malloc((size_t) size) : NULL;
+    if (!ips || fread(ips, 1, (size_t) size, file) != (size_t) size) {
+        free(ips);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    // "PATCH", records of {u24 offset, u16 size, data} or
+    // {u24 offset, u16 0, u16 count, u8 value}, "EOF", optional u24 truncate
+    const u8 *p = ips + 5, *end = ips + size;
+    int ret = -1;
+    if (size < 8 || memcmp(ips, "PATCH", 5) != 0) {
+        goto done;
+    }
+
+    while (end - p >= 3) {
+        u32 offset = ipsRead(p, 3);
+        p += 3;
+        if (offset == 0x454f46) { // "EOF"
+            if (end - p >= 3) {
+                u32 truncate = ipsRead(p, 3);
+                if (truncate < staging->size) {
+                    staging->size = truncate;
+                }
+            }
+            ret = 0;
+            break;
+        }
+        if (end - p < 2) {
+            break;
+        }
+        u32 len = ipsRead(p, 2);
+        p += 2;
+        const u8 *data = p;
+        bool rle = len == 0;
+        if (rle) {
+            if (end - p < 3) {
+                break;
+            }
+            len = ipsRead(p, 2);
+            data = p + 2;
+            p += 3;
+        } else if ((u32) (end - p) < len) {
+            break;
+        } else {
+            p += len;
+        }
+
+        if (offset + len > staging->max) {
+            staging->overflow = true;
+            break;
+        }
+        if (offset > staging->size) {
+            memset(staging->buf + staging->size, 0, offset - staging->size);
+        }
+        if (rle) {
+            memset(staging->buf + offset, *data, len);
+        } else {
+            memcpy(staging->buf + offset, data, len);
+        }
+        if (offset + len > staging->size) {
+            staging->size = offset + len;
+        }
+    }
+
+    done:
+    free(ips);
+    return ret;
+}
+
+long payloadStage(const char *path, long offset, u32 flags, const char *patch, u8 *buf, size_t max) {
+
+    payload_staging_s staging;
+    payloadStagingInit(&staging, buf, max);
+
+    int ret;
+    if (flags & PAYLOAD_ZLIB) {
+        payload_inflate_s *inflate_stage = malloc(sizeof(payload_inflate_s));
+        if (!inflate_stage) {
+            return -1;
+        }
+        if (payloadInflateInit(inflate_stage, &staging.stage) != 0) {
+            free(inflate_stage);
+            return -1;
+        }
+        ret = payloadRead(path, offset, (size_t) -1, &inflate_stage->stage);
+        payloadInflateEnd(inflate_stage);
+        free(inflate_stage);
+    } else {
+        // like load_arm9_payload_offset, anything past max is ignored
+        ret = payloadRead(path, offset, max, &staging.stage);
+    }
+
+    if (ret == 0 && patch && *patch) {
+        ret = payloadPatch(&staging, patch);
+    }
+
+    if (staging.overflow) {
+        return PAYLOAD_TOO_LARGE;
+    }
+    return ret == 0 ? (long) staging.size : PAYLOAD_ERROR;
+}
@@ -0,0 +1,61 @@
+#ifndef _payload_h_
+#define _payload_h_
+
+#include <zlib.h>
+
+// sd reads are done in aligned blocks of this size
+#define PAYLOAD_CHUNK 0x10000
+
+enum {
+    PAYLOAD_ZLIB = BIT(0)   // zlib or gzip compressed
+};
+
+// payloadStage errors
+enum {
+    PAYLOAD_ERROR = -1,     // read, inflate or patch failed
+    PAYLOAD_TOO_LARGE = -2  // inflated or patched payload past the staging buffer
+};
+
+// a pipeline stage receives the output of the previous one,
+// stages only use stdio and zlib so they also build on a host
+typedef struct payload_stage_s {
+    int (*write)(struct payload_stage_s *stage, const u8 *data, size_t size);
+    int (*finish)(struct payload_stage_s *stage);
+    struct payload_stage_s *next;
+} payload_stage_s;
+
+// last stage: the arm9 staging buffer
+typedef struct {
+    payload_stage_s stage;
+    u8 *buf;
+    size_t size;
+    size_t max;
+    bool overflow;  // a write or patch didn't fit, the pipeline stopped there
+} payload_staging_s;
+
+typedef struct {
+    payload_stage_s stage;
+    z_stream z;
+    bool done;
+    u8 out[PAYLOAD_CHUNK];
+} payload_inflate_s;
+
+void payloadStagingInit(payload_staging_s *staging, u8 *buf, size_t max);
+
+int payloadInflateInit(payload_inflate_s *inflate, payload_stage_s *next);
+
+void payloadInflateEnd(payload_inflate_s *inflate);
+
+// read path from offset to its end (or max bytes) and push it down the pipeline
+int payloadRead(const char *path, long offset, size_t max, payload_stage_s *first);
+
+// apply an ips patch to the staged payload
+int payloadPatch(payload_staging_s *staging, const char *path);
+
+// the whole pipeline: read, optionally inflate and patch into buf,
+// returns the payload size, PAYLOAD_ERROR or PAYLOAD_TOO_LARGE:
+// a raw payload is cut at max (like load_arm9_payload_offset), an inflated
+// one is rejected as soon as its output passes max
+long payloadStage(const char *path, long offset, u32 flags, const char *patch, u8 *buf, size_t max);
+
+#endif // _payload_h_
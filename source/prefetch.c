@@ -0,0 +1,166 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "prefetch.h"
+
+#define PREFETCH_STACK_SIZE 0x4000
+
+static Thread prefetch_thread = NULL;
+static Handle prefetch_event = 0;
+static LightLock prefetch_lock;
+static volatile bool prefetch_quit = false;
+
+// target, owned by the main thread and guarded by prefetch_lock
+static char prefetch_path[512];
+static long prefetch_offset = 0;
+static u32 prefetch_size = 0;
+static volatile u32 prefetch_gen = 0;
+
+// what the buffer holds once a read completed
+static u32 prefetch_done_gen = 0;
+static u32 prefetch_read = 0;
+static u8 *prefetch_buf = NULL;
+static u32 prefetch_capacity = 0;
+
+static void prefetchThread(void *arg) {
+
+    char path[512];
+
+    while (!prefetch_quit) {
+        svcWaitSynchronization(prefetch_event, U64_MAX);
+        if (prefetch_quit) {
+            break;
+        }
+
+        LightLock_Lock(&prefetch_lock);
+        u32 gen = prefetch_gen;
+        long offset = prefetch_offset;
+        u32 size = prefetch_size;
+        strcpy(path, prefetch_path);
+        LightLock_Unlock(&prefetch_lock);
+
+        FILE *file = fopen(path, "rb");
+        if (file == NULL) {
+            continue;
+        }
+        bool ok = fseek(file, offset, SEEK_SET) == 0;
+        u32 read = 0;
+        while (ok && read < size && gen == prefetch_gen && !prefetch_quit) {
+            u32 len = size - read < PREFETCH_CHUNK ? size - read : PREFETCH_CHUNK;
+            size_t n = fread(prefetch_buf + read, 1, len, file);
+            read += n;
+            if (n < len) {
+                // payloads are usually smaller than the max size
+                ok = !ferror(file);
+                break;
+            }
+        }
+        fclose(file);
+
+        LightLock_Lock(&prefetch_lock);
+        if (ok && read > 0 && gen == prefetch_gen && !prefetch_quit) {
+            prefetch_read = read;
+            prefetch_done_gen = gen;
+        }
+        LightLock_Unlock(&prefetch_lock);
+    }
+}
+
+int prefetchStart(u32 capacity) {
+
+    if (prefetch_thread) {
+        return 0;
+    }
+
+    if (capacity != prefetch_capacity) {
+        free(prefetch_buf);
+        prefetch_buf = malloc(capacity);
+        prefetch_capacity = prefetch_buf ? capacity : 0;
+        // the old data is gone
+        prefetch_done_gen = 0;
+        if (!prefetch_buf) {
+            return -1;
+        }
+    }
+
+    LightLock_Init(&prefetch_lock);
+    if (svcCreateEvent(&prefetch_event, RESET_ONESHOT) != 0) {
+        return -1;
+    }
+
+    // below the main thread, so it only reads while the menu waits for vblank
+    s32 prio = 0x30;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    prefetch_quit = false;
+    prefetch_thread = threadCreate(prefetchThread, NULL, PREFETCH_STACK_SIZE, prio + 1, -2, false);
+    if (!prefetch_thread) {
+        svcCloseHandle(prefetch_event);
+        prefetch_event = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+void prefetchTarget(const char *path, long offset, u32 size) {
+
+    if (!prefetch_thread) {
+        return;
+    }
+    if (size > prefetch_capacity) {
+        size = prefetch_capacity;
+    }
+
+    LightLock_Lock(&prefetch_lock);
+    if (offset == prefetch_offset && size == prefetch_size
+        && strcmp(path, prefetch_path) == 0) {
+        LightLock_Unlock(&prefetch_lock);
+        return;
+    }
+    strncpy(prefetch_path, path, sizeof(prefetch_path) - 1);
+    prefetch_path[sizeof(prefetch_path) - 1] = '\0';
+    prefetch_offset = offset;
+    prefetch_size = size;
+    // whatever is being read, or was read, is now stale
+    prefetch_gen++;
+    LightLock_Unlock(&prefetch_lock);
+
+    svcSignalEvent(prefetch_event);
+}
+
+void prefetchStop() {
+
+    if (!prefetch_thread) {
+        return;
+    }
+
+    prefetch_quit = true;
+    svcSignalEvent(prefetch_event);
+    threadJoin(prefetch_thread, U64_MAX);
+    threadFree(prefetch_thread);
+    svcCloseHandle(prefetch_event);
+    prefetch_thread = NULL;
+    prefetch_event = 0;
+}
+
+void prefetchExit() {
+    prefetchStop();
+    free(prefetch_buf);
+    prefetch_buf = NULL;
+    prefetch_capacity = 0;
+    prefetch_done_gen = 0;
+}
+
+u8 *prefetchGet(const char *path, long offset, u32 *size) {
+
+    // only valid once the reader is gone
+    if (prefetch_thread || prefetch_done_gen != prefetch_gen || prefetch_gen == 0
+        || offset != prefetch_offset || strcmp(path, prefetch_path) != 0) {
+        return NULL;
+    }
+
+    *size = prefetch_read;
+    return prefetch_buf;
+}
@@ -0,0 +1,26 @@
+#ifndef _prefetch_h_
+#define _prefetch_h_
+
+// payload read per step of the prefetch thread, it gives up
+// between two steps when the target changes
+#define PREFETCH_CHUNK 0x4000
+
+// start the background reader with a buffer of capacity bytes,
+// it only runs while the main thread waits (vblank)
+int prefetchStart(u32 capacity);
+
+// read size bytes of path at offset in the background,
+// a previous target still being read is dropped
+void prefetchTarget(const char *path, long offset, u32 size);
+
+// stop the reader, a completed prefetch stays available
+void prefetchStop();
+
+// stop the reader and release its buffer
+void prefetchExit();
+
+// prefetched data of path at offset if it was read completely, NULL otherwise,
+// only available after prefetchStop()
+u8 *prefetchGet(const char *path, long offset, u32 *size);
+
+#endif // _prefetch_h_
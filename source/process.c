@@ -0,0 +1,67 @@
+#include <3ds.h>
+#include <string.h>
+
+#include "process.h"
+
+// needed services a candidate provides, counted per priority
+typedef struct {
+    bool complete;
+    u8 counts[PROCESS_PRIORITY_LOWEST];    // counts[0]: priority 1
+} process_score_s;
+
+static void processScore(const processEntry_s *candidate, const u8 *priorities, int numServices,
+                         process_score_s *score) {
+    memset(score, 0, sizeof(process_score_s));
+    score->complete = true;
+    int i;
+    for (i = 0; i < numServices; i++) {
+        if (!priorities[i]) {
+            continue;
+        }
+        if (candidate->capabilities[i]) {
+            u8 priority = priorities[i] > PROCESS_PRIORITY_LOWEST ? PROCESS_PRIORITY_LOWEST : priorities[i];
+            score->counts[priority - 1]++;
+        } else {
+            score->complete = false;
+        }
+    }
+}
+
+// > 0 if a is the better fit: complete first, then the counts from
+// the highest priority down, so one more service of a priority beats
+// any number of lower priority ones
+static int processCompare(const process_score_s *a, const process_score_s *b) {
+    if (a->complete != b->complete) {
+        return a->complete ? 1 : -1;
+    }
+    int i;
+    for (i = 0; i < PROCESS_PRIORITY_LOWEST; i++) {
+        if (a->counts[i] != b->counts[i]) {
+            return a->counts[i] > b->counts[i] ? 1 : -1;
+        }
+    }
+    return 0;
+}
+
+int processSelect(const processEntry_s *candidates, int count, const u8 *priorities, int numServices) {
+
+    if (numServices > PROCESS_SERVICES_MAX) {
+        numServices = PROCESS_SERVICES_MAX;
+    }
+
+    int best = -1;
+    process_score_s bestScore;
+    int i;
+    for (i = 0; i < count; i++) {
+        process_score_s score;
+        processScore(&candidates[i], priorities, numServices, &score);
+        int cmp = best < 0 ? 1 : processCompare(&score, &bestScore);
+        // strictly better only, the bootloader lists its best fit first
+        if (cmp > 0) {
+            best = i;
+            bestScore = score;
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,29 @@
+#ifndef _process_h_
+#define _process_h_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// capability slots reported by the ninjhax 2.x bootloader per process
+#define PROCESS_SERVICES_MAX 0x10
+
+// descriptor priorities: 1 is the highest, anything past this counts as it
+#define PROCESS_PRIORITY_LOWEST 8
+
+// a candidate process returned by getBestProcess_2x
+typedef struct {
+    int processId;
+    bool capabilities[PROCESS_SERVICES_MAX];
+} processEntry_s;
+
+// index of the best candidate for the given service priorities (0: not needed),
+// a process providing every needed service wins, then the one with the most
+// highest priority services (then the most of the next priority...), then
+// the bootloader order, -1 if there's no candidate
+int processSelect(const processEntry_s *candidates, int count, const u8 *priorities, int numServices);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _process_h_
@@ -0,0 +1,89 @@
+#include <3ds.h>
+
+#include "gfx.h"
+#include "ready.h"
+#include "trace.h"
+
+// time between two polls of the pending conditions
+#define READY_POLL_NS 1000000LL
+
+static u64 ready_start = 0;
+static u64 ready_hid_tick = 0;
+static bool ready_hid_seen = false;
+
+static ready_cond_s ready_conds[READY_COUNT] = {
+        {"hid"},
+        {"apt"},
+        {"display"}
+};
+
+static bool readyHid() {
+
+    if (!hidSharedMem) {
+        return true;
+    }
+
+    // timestamp of the latest pad entry, the hid module
+    // writes a new one every few ms once it's up
+    u64 tick = hidSharedMem[0] | (u64) hidSharedMem[1] << 32;
+    if (!ready_hid_seen) {
+        ready_hid_tick = tick;
+        ready_hid_seen = true;
+        return false;
+    }
+    return tick != ready_hid_tick;
+}
+
+static bool readyApt() {
+    return aptGetStatus() == APP_RUNNING;
+}
+
+static bool readyDisplay() {
+    // one flushed frame and its vblank
+    gfxSwap();
+    return true;
+}
+
+static bool (*const ready_checks[READY_COUNT])() = {
+        readyHid,
+        readyApt,
+        readyDisplay
+};
+
+u32 readyWait(u32 conditions, u32 timeoutMs) {
+
+    u64 now = svcGetSystemTick();
+    if (!ready_start) {
+        ready_start = now;
+    }
+    u64 deadline = now + (u64) timeoutMs * (SYSCLOCK_ARM11 / 1000);
+
+    int i;
+    u32 pending = conditions;
+    for (i = 0; i < READY_COUNT; i++) {
+        if (ready_conds[i].ready) {
+            pending &= ~BIT(i);
+        }
+    }
+
+    while (pending) {
+        for (i = 0; i < READY_COUNT; i++) {
+            if (pending & BIT(i) && ready_checks[i]()) {
+                ready_conds[i].ready = true;
+                ready_conds[i].ticks = svcGetSystemTick() - ready_start;
+                traceMark((trace_phase_e) (TRACE_READY_HID + i));
+                pending &= ~BIT(i);
+            }
+        }
+        if (!pending || svcGetSystemTick() >= deadline) {
+            break;
+        }
+        svcSleepThread(READY_POLL_NS);
+    }
+
+    return pending;
+}
+
+const ready_cond_s *readyCondition(int index) {
+    return index >= 0 && index < READY_COUNT ? &ready_conds[index] : NULL;
+}
@@ -0,0 +1,29 @@
+#ifndef _ready_h_
+#define _ready_h_
+
+// conditions the autoboot has to wait for before handing over
+enum {
+    READY_HID = BIT(0),     // hid produced a fresh sample, held keys can be trusted
+    READY_APT = BIT(1),     // the applet is running (not suspended or exiting)
+    READY_DISPLAY = BIT(2), // a frame was presented, the gpu is idle
+    READY_ALL = READY_HID | READY_APT | READY_DISPLAY
+};
+
+#define READY_COUNT 3
+
+// autobootfix is given in frames (60 per second)
+#define READY_FRAMES_MS(frames) ((u32) (frames) * 1000 / 60)
+
+typedef struct {
+    const char *name;
+    bool ready;
+    u64 ticks;      // time the condition took, from the first readyWait
+} ready_cond_s;
+
+// poll the given conditions until they're all met or the timeout expires,
+// returns the conditions that are still not ready
+u32 readyWait(u32 conditions, u32 timeoutMs);
+
+const ready_cond_s *readyCondition(int index);
+
+#endif // _ready_h_
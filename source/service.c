@@ -0,0 +1,168 @@
+#include <3ds.h>
+
+#include "service.h"
+#include "trace.h"
+#include "utility.h"
+
+#define SERVICE_STACK_SIZE 0x2000
+
+enum {
+    SERVICE_IDLE,
+    SERVICE_QUEUED,     // owned by the worker until ready or failed
+    SERVICE_READY,
+    SERVICE_FAILED
+};
+
+typedef struct {
+    const char *name;
+    u32 deps;
+    Result (*init)();
+    void (*exit)();
+    volatile u8 state;
+} service_s;
+
+static Result sdmcInitService() {
+    return sdmcInit();
+}
+
+static void sdmcExitService() {
+    sdmcExit();
+}
+
+static Result sdArchiveInit() {
+    openSDArchive();
+    return 0;
+}
+
+static service_s service_table[SERVICE_COUNT] = {
+        {"srv",        0,                          srvInit,         srvExit},
+        {"apt",        SERVICE_SRV,                aptInit,         aptExit},
+        {"fs",         SERVICE_SRV,                fsInit,          fsExit},
+        {"sdmc",       SERVICE_FS,                 sdmcInitService, sdmcExitService},
+        {"sd archive", SERVICE_FS,                 sdArchiveInit,   closeSDArchive},
+        {"hid",        SERVICE_SRV,                hidInit,         hidExit},
+        {"ac",         SERVICE_SRV,                acInit,          acExit},
+        {"ptmu",       SERVICE_SRV,                ptmuInit,        ptmuExit},
+        {"am",         SERVICE_SRV,                amInit,          amExit}
+};
+
+static Thread service_thread = NULL;
+static Handle service_event = 0;    // signaled each time the worker is done with one
+static u32 service_queued = 0;
+
+// services plus everything they depend on
+static u32 serviceClosure(u32 services) {
+    int i;
+    for (i = SERVICE_COUNT - 1; i >= 0; i--) {
+        if (services & BIT(i)) {
+            services |= service_table[i].deps;
+        }
+    }
+    return services;
+}
+
+static void serviceBringUp(int i) {
+    Result ret = service_table[i].init();
+    traceMarkArg(TRACE_SERVICE, (u8) i);
+    service_table[i].state = R_SUCCEEDED(ret) ? SERVICE_READY : SERVICE_FAILED;
+}
+
+static void serviceThread(void *arg) {
+
+    int i;
+    for (i = 0; i < SERVICE_COUNT; i++) {
+        if (service_queued & BIT(i)) {
+            serviceBringUp(i);
+            svcSignalEvent(service_event);
+        }
+    }
+}
+
+int serviceStart(u32 services) {
+
+    if (service_thread) {
+        return -1;
+    }
+
+    u32 queued = 0;
+    int i;
+    services = serviceClosure(services);
+    for (i = 0; i < SERVICE_COUNT; i++) {
+        if (services & BIT(i) && service_table[i].state == SERVICE_IDLE) {
+            queued |= BIT(i);
+        }
+    }
+    if (!queued || svcCreateEvent(&service_event, RESET_ONESHOT) != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < SERVICE_COUNT; i++) {
+        if (queued & BIT(i)) {
+            service_table[i].state = SERVICE_QUEUED;
+        }
+    }
+    service_queued = queued;
+
+    // above the main thread: it sends its requests first and the main thread
+    // runs while they're served, the second core is left alone since
+    // main() gives it no cpu time (APT_SetAppCpuTimeLimit)
+    s32 prio = 0x30;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    service_thread = threadCreate(serviceThread, NULL, SERVICE_STACK_SIZE, prio - 1, -2, false);
+    if (!service_thread) {
+        // serviceWait does them inline
+        for (i = 0; i < SERVICE_COUNT; i++) {
+            if (queued & BIT(i)) {
+                service_table[i].state = SERVICE_IDLE;
+            }
+        }
+        service_queued = 0;
+        svcCloseHandle(service_event);
+        service_event = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+u32 serviceWait(u32 services) {
+
+    u32 failed = 0;
+    int i;
+    services = serviceClosure(services);
+    for (i = 0; i < SERVICE_COUNT; i++) {
+        if (!(services & BIT(i))) {
+            continue;
+        }
+        while (service_table[i].state == SERVICE_QUEUED) {
+            svcWaitSynchronization(service_event, U64_MAX);
+        }
+        if (service_table[i].state == SERVICE_IDLE) {
+            serviceBringUp(i);
+        }
+        if (service_table[i].state == SERVICE_FAILED) {
+            failed |= BIT(i);
+        }
+    }
+
+    return failed;
+}
+
+void serviceExit() {
+
+    if (service_thread) {
+        threadJoin(service_thread, U64_MAX);
+        threadFree(service_thread);
+        svcCloseHandle(service_event);
+        service_thread = NULL;
+        service_event = 0;
+    }
+
+    int i;
+    for (i = SERVICE_COUNT - 1; i >= 0; i--) {
+        if (service_table[i].state == SERVICE_READY) {
+            service_table[i].exit();
+        }
+        service_table[i].state = SERVICE_IDLE;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef _service_h_
+#define _service_h_
+
+// system services, in init order: a service only depends on earlier ones
+enum {
+    SERVICE_SRV = BIT(0),
+    SERVICE_APT = BIT(1),
+    SERVICE_FS = BIT(2),
+    SERVICE_SDMC = BIT(3),          // stdio on sdmc:/
+    SERVICE_SD_ARCHIVE = BIT(4),    // raw FSUSER archive, 3dsx launch only
+    SERVICE_HID = BIT(5),
+    SERVICE_AC = BIT(6),
+    SERVICE_PTMU = BIT(7),
+    SERVICE_AM = BIT(8)
+};
+
+#define SERVICE_COUNT 9
+
+// bring up services (and what they depend on) on a worker thread,
+// only once, they're done inline by serviceWait if it can't be created
+int serviceStart(u32 services);
+
+// block until services are up, the ones never started are brought up inline,
+// returns the services that failed
+u32 serviceWait(u32 services);
+
+// stop every service that was brought up, in reverse order
+void serviceExit();
+
+#endif // _service_h_
@@ -0,0 +1,105 @@
+#include <3ds.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _3DS
+#include <time.h>
+#endif
+
+#include "trace.h"
+
+static trace_boot_s trace_boot;
+static LightLock trace_lock;
+static bool trace_enabled = false;
+static bool trace_written = false;
+
+// SYSCLOCK_ARM11 ticks, host builds count them from clock_gettime
+// so their logs read the same as the console ones
+static u64 traceTicks() {
+#ifdef _3DS
+    return svcGetSystemTick();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64) ts.tv_sec * SYSCLOCK_ARM11 + (u64) ts.tv_nsec * SYSCLOCK_ARM11 / 1000000000;
+#endif
+}
+
+void traceStart() {
+    LightLock_Init(&trace_lock);
+    memset(&trace_boot, 0, sizeof(trace_boot_s));
+    trace_boot.start = traceTicks();
+}
+
+void traceMarkArg(trace_phase_e phase, u8 arg) {
+
+    u64 ticks = traceTicks() - trace_boot.start;
+
+    LightLock_Lock(&trace_lock);
+    // the last slot is kept for the handover
+    if (trace_boot.count < TRACE_EVENTS - (phase != TRACE_HANDOVER)) {
+        trace_event_s *event = &trace_boot.events[trace_boot.count++];
+        event->phase = (u8) phase;
+        event->arg = arg;
+        event->us = (u32) (ticks / (SYSCLOCK_ARM11 / 1000000));
+    }
+    LightLock_Unlock(&trace_lock);
+}
+
+void traceMark(trace_phase_e phase) {
+    traceMarkArg(phase, 0);
+}
+
+void traceEnable(bool enable) {
+    trace_enabled = enable;
+}
+
+static int traceWrite() {
+
+    trace_header_s hdr;
+    FILE *file = fopen(TRACE_PATH, "r+b");
+    if (file == NULL
+        || fread(&hdr, 1, sizeof(trace_header_s), file) != sizeof(trace_header_s)
+        || hdr.magic != TRACE_MAGIC || hdr.version != TRACE_VERSION
+        || hdr.next >= TRACE_BOOTS) {
+        // missing or from another version: start a new log
+        if (file != NULL) {
+            fclose(file);
+        }
+        file = fopen(TRACE_PATH, "wb");
+        if (file == NULL) {
+            return -1;
+        }
+        hdr.magic = TRACE_MAGIC;
+        hdr.version = TRACE_VERSION;
+        hdr.boots = 0;
+        hdr.next = 0;
+    }
+
+    // only the record is rewritten, the other boots stay in place
+    long pos = (long) (sizeof(trace_header_s) + hdr.next * sizeof(trace_boot_s));
+    bool ok = fseek(file, pos, SEEK_SET) == 0
+              && fwrite(&trace_boot, 1, sizeof(trace_boot_s), file) == sizeof(trace_boot_s);
+    if (ok) {
+        hdr.boots++;
+        hdr.next = (hdr.next + 1) % TRACE_BOOTS;
+        ok = fseek(file, 0, SEEK_SET) == 0
+             && fwrite(&hdr, 1, sizeof(trace_header_s), file) == sizeof(trace_header_s);
+    }
+    fclose(file);
+
+    return ok ? 0 : -1;
+}
+
+void traceEnd() {
+
+    if (trace_written) {
+        return;
+    }
+    trace_written = true;
+
+    traceMark(TRACE_HANDOVER);
+    if (trace_enabled) {
+        traceWrite();
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef _trace_h_
+#define _trace_h_
+
+#define TRACE_PATH "/boot.trace"
+#define TRACE_MAGIC 0x43525442 // 'BTRC'
+#define TRACE_VERSION 1
+#define TRACE_BOOTS 16      // boots kept in the log, oldest overwritten first
+#define TRACE_EVENTS 30     // events recorded per boot
+
+// boot phases, a mark is taken when the phase is done
+typedef enum {
+    TRACE_APP_INIT,         // services and gfx up (__appInit)
+    TRACE_CONFIG,           // boot.cfg (or its cache) loaded
+    TRACE_KEYS,             // boot keys resolved
+    TRACE_READY_HID,        // readyWait conditions, see ready.h
+    TRACE_READY_APT,
+    TRACE_READY_DISPLAY,
+    TRACE_THEME,            // background images loaded
+    TRACE_MENU,             // boot menu shown
+    TRACE_NETLOADER,        // netloader started
+    TRACE_PAYLOAD,          // payload read and staged
+    TRACE_DESCRIPTOR,       // 3dsx descriptor loaded and scanned, arg: descriptorHighWater / 64
+    TRACE_HANDOVER,         // last mark, payload or 3dsx launched
+    TRACE_SERVICE,          // a system service is up, arg: its index (see service.c)
+    TRACE_SCAN              // launched 3dsx scanned, arg: KiB read (see scanStats)
+} trace_phase_e;
+
+typedef struct {
+    u8 phase;
+    u8 arg;
+    u8 pad[2];
+    u32 us;                 // since traceStart
+} trace_event_s;
+
+// one boot in the log
+typedef struct {
+    u64 start;              // system tick of traceStart, time since power-on
+    u32 count;
+    trace_event_s events[TRACE_EVENTS];
+} trace_boot_s;
+
+// log layout: header, then TRACE_BOOTS records
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 boots;              // total boots written
+    u32 next;               // record written on the next boot
+} trace_header_s;
+
+void traceStart();
+
+// record the end of a phase, dropped once the buffer is full,
+// can be called from any thread
+void traceMark(trace_phase_e phase);
+
+void traceMarkArg(trace_phase_e phase, u8 arg);
+
+// write this boot to the log on traceEnd(), off by default
+void traceEnable(bool enable);
+
+// mark the handover and write the log once, before leaving the app
+void traceEnd();
+
+#endif // _trace_h_
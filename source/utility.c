@@ -79,6 +79,16 @@ char *get_button(int button) {
     }
 }
 
+// "L+A" style name of a key mask
+void get_buttons(u32 keys, char *out, size_t size) {
+    size_t len = 0;
+    out[0] = '\0';
+    while (keys && len < size) {
+        len += snprintf(out + len, size - len, len ? "+%s" : "%s", get_button(__builtin_ctz(keys)));
+        keys &= keys - 1;
+    }
+}
+
 void debug(const char *fmt, ...) {
     char s[512];
     memset(s, 0, 512);
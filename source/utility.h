@@ -27,6 +27,8 @@ bool end_with(const char *str, const char c);
 
 char *get_button(int button);
 
+void get_buttons(u32 keys, char *out, size_t size);
+
 void debug(const char *fmt, ...);
 
 bool confirm(int confirmButton, const char *fmt, ...);
@@ -0,0 +1,105 @@
+#include <3ds.h>
+#include <stdio.h>
+
+#include <zlib.h>
+#include "verify.h"
+
+// the check runs a chunk at a time from the boot menu loop,
+// so it overlaps the countdown instead of delaying the boot
+static boot_entry_s *verify_entry = NULL;
+static FILE *verify_file = NULL;
+static u32 verify_crc = 0;
+static u8 verify_buf[VERIFY_CHUNK];
+
+static void verifyDone(u8 state) {
+    verify_entry->verify = state;
+    verifyStop();
+}
+
+void verifyStart(boot_entry_s *entry) {
+
+    if (entry == verify_entry
+        || entry->verify != VERIFY_NONE
+        || (!entry->size && !entry->hasCrc)) {
+        return;
+    }
+
+    verifyStop();
+    verify_entry = entry;
+    entry->verify = VERIFY_PENDING;
+
+    verify_file = fopen(entry->path, "rb");
+    if (!verify_file) {
+        verifyDone(VERIFY_MISSING);
+        return;
+    }
+
+    // a size mismatch doesn't need the hash
+    fseek(verify_file, 0, SEEK_END);
+    long size = ftell(verify_file);
+    fseek(verify_file, 0, SEEK_SET);
+    if (size < 0 || (entry->size && (u32) size != entry->size)) {
+        verifyDone(VERIFY_BAD_SIZE);
+        return;
+    }
+    if (!entry->hasCrc) {
+        verifyDone(VERIFY_OK);
+        return;
+    }
+
+    verify_crc = (u32) crc32(0L, Z_NULL, 0);
+}
+
+bool verifyStep() {
+
+    if (!verify_file) {
+        return false;
+    }
+
+    size_t read = fread(verify_buf, 1, VERIFY_CHUNK, verify_file);
+    if (read > 0) {
+        verify_crc = (u32) crc32(verify_crc, verify_buf, (uInt) read);
+    }
+
+    if (read < VERIFY_CHUNK) {
+        if (ferror(verify_file)) {
+            verifyDone(VERIFY_MISSING);
+        } else {
+            verifyDone(verify_crc == verify_entry->crc ? VERIFY_OK : VERIFY_BAD_CRC);
+        }
+        return false;
+    }
+
+    return true;
+}
+
+void verifyStop() {
+
+    if (verify_file) {
+        fclose(verify_file);
+        verify_file = NULL;
+    }
+    // an interrupted check starts over next time
+    if (verify_entry && verify_entry->verify == VERIFY_PENDING) {
+        verify_entry->verify = VERIFY_NONE;
+    }
+    verify_entry = NULL;
+}
+
+const char *verifyStatus(const boot_entry_s *entry) {
+
+    switch (entry->verify) {
+        case VERIFY_PENDING:
+            return "checking...";
+        case VERIFY_OK:
+            return "ok";
+        case VERIFY_MISSING:
+            return "FAILED (couldn't read payload)";
+        case VERIFY_BAD_SIZE:
+            return "FAILED (size mismatch)";
+        case VERIFY_BAD_CRC:
+            return "FAILED (crc32 mismatch)";
+        default:
+            return entry->size || entry->hasCrc ? "not checked" : "none";
+    }
+}
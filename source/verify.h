@@ -0,0 +1,20 @@
+#ifndef _verify_h_
+#define _verify_h_
+
+#include "config.h"
+
+// payload read per verifyStep() call, about one frame of sd reads
+#define VERIFY_CHUNK 0x8000
+
+// start checking entry against its size/crc32 from boot.cfg,
+// nothing to do if the entry has none or was already checked
+void verifyStart(boot_entry_s *entry);
+
+// hash the next chunk of the current entry, false once idle
+bool verifyStep();
+
+void verifyStop();
+
+const char *verifyStatus(const boot_entry_s *entry);
+
+#endif // _verify_h_
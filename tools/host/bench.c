@@ -0,0 +1,86 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+static bool bench_first = true;
+
+u64 benchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64) ts.tv_sec * 1000000000 + (u64) ts.tv_nsec;
+}
+
+u32 benchInit(int argc, char **argv, u32 def) {
+
+    u32 iterations = def;
+    int i;
+    for (i = 1; i < argc - 1; i++) {
+        if (!strcmp(argv[i], "--iterations")) {
+            iterations = (u32) strtoul(argv[i + 1], NULL, 0);
+        }
+    }
+
+    mkdir(hostPath("/"), 0755);
+    return iterations > 0 ? iterations : 1;
+}
+
+void benchBegin(const char *suite) {
+    printf("{\"suite\": \"%s\", \"results\": [", suite);
+    bench_first = true;
+}
+
+void benchStart(bench_s *b, const char *name) {
+    b->name = name;
+    b->iterations = 0;
+    b->totalNs = 0;
+    b->minNs = UINT64_MAX;
+    b->maxNs = 0;
+}
+
+void benchAdd(bench_s *b, u64 ns) {
+    b->iterations++;
+    b->totalNs += ns;
+    if (ns < b->minNs) {
+        b->minNs = ns;
+    }
+    if (ns > b->maxNs) {
+        b->maxNs = ns;
+    }
+}
+
+void benchReport(const bench_s *b, const char *fmt, ...) {
+
+    printf("%s\n  {\"name\": \"%s\"", bench_first ? "" : ",", b->name);
+    bench_first = false;
+    if (fmt) {
+        va_list args;
+        va_start(args, fmt);
+        printf(", ");
+        vprintf(fmt, args);
+        va_end(args);
+    }
+    printf(", \"iterations\": %lu, \"mean_ns\": %llu, \"min_ns\": %llu, \"max_ns\": %llu}",
+           (unsigned long) b->iterations,
+           (unsigned long long) (b->iterations ? b->totalNs / b->iterations : 0),
+           (unsigned long long) (b->iterations ? b->minNs : 0),
+           (unsigned long long) b->maxNs);
+}
+
+void benchEnd() {
+    printf("\n]}\n");
+    fflush(stdout);
+}
+
+int benchWriteFile(const char *path, const void *data, size_t size) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+    size_t written = fwrite(data, 1, size, file);
+    fclose(file);
+    return written == size ? 0 : -1;
+}
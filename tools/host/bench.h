@@ -0,0 +1,41 @@
+#ifndef _bench_h_
+#define _bench_h_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// timing and json output shared by the host benchmarks:
+// {"suite": "config", "results": [{"name": "parse", "entries": 64, "iterations": 20, ...}, ...]}
+typedef struct {
+    const char *name;
+    u32 iterations;
+    u64 totalNs;
+    u64 minNs;
+    u64 maxNs;
+} bench_s;
+
+// monotonic clock, in ns
+u64 benchNow();
+
+// iterations per benchmark from "--iterations n" (or def), the sd root is created
+u32 benchInit(int argc, char **argv, u32 def);
+
+void benchBegin(const char *suite);
+
+void benchStart(bench_s *b, const char *name);
+
+void benchAdd(bench_s *b, u64 ns);
+
+// one result, fmt adds the parameters ("\"entries\": %d", 64) or is NULL
+void benchReport(const bench_s *b, const char *fmt, ...);
+
+void benchEnd();
+
+// write size bytes of data to an sd path (see hostPath)
+int benchWriteFile(const char *path, const void *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _bench_h_
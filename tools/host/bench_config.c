@@ -0,0 +1,284 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <utime.h>
+
+#include <libconfig.h>
+#include "config.h"
+#include "config_cache.h"
+#include "config_journal.h"
+#include "config_schema.h"
+#include "bench.h"
+
+// boot.cfg handling off-device: parse, binary cache, journal, theme, images
+// usage: bench_config [--iterations n] > config.json
+
+#define BENCH_CFG_PATH "/boot.cfg"
+#define BENCH_IMG_TOP "/bench_top.bin"
+#define BENCH_IMG_BOT "/bench_bot.bin"
+
+// config.c internals measured on their own
+int configParse();
+
+// boot.cfg mtime, 0 for a fs without one
+static void benchMtime(time_t mtime) {
+    struct utimbuf times = {mtime, mtime};
+    utime(hostPath(BENCH_CFG_PATH), &times);
+}
+
+static const int bench_entries[] = {8, 64, 256, 1024};
+
+// a boot.cfg like data/boot.cfg, with count entries
+static int benchConfig(int count) {
+
+    FILE *file = fopen(BENCH_CFG_PATH, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    fprintf(file, "boot_config =\n{\n\ttimeout = 3;\n\tautobootfix = 8;\n\trecovery = 2;\n\tdefault = 0;\n");
+    fprintf(file, "\tentries =\n\t(\n");
+    int i;
+    for (i = 0; i < count; i++) {
+        fprintf(file, "\t\t{\n\t\t\ttitle = \"Entry %d\";\n\t\t\tpath = \"/payloads/entry%d.bin\";\n", i, i);
+        switch (i % 4) {
+            case 0:
+                fprintf(file, "\t\t\toffset = \"0x12000\";\n\t\t\tkey = %d;\n", i % 12);
+                break;
+            case 1:
+                fprintf(file, "\t\t\tsize = 131072;\n\t\t\tcrc32 = \"0x1a2b3c4d\";\n\t\t\tkey = [9, %d];\n", i % 9);
+                break;
+            case 2:
+                fprintf(file, "\t\t\tcompression = \"zlib\";\n\t\t\tpatch = \"/payloads/entry%d.ips\";\n", i);
+                break;
+            default:
+                fprintf(file, "\t\t\targs = [\"-sd\", \"/cias/%d\"];\n", i);
+                break;
+        }
+        fprintf(file, "\t\t}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(file, "\t);\n\ttheme =\n\t{\n"
+                  "\t\tbgTop1 = \"4a0031\";\n\t\tbgTop2 = \"6f0149\";\n\t\tbgBottom = \"6f0149\";\n"
+                  "\t\thighlight = \"dcdcdc\";\n\t\tborders = \"ffffff\";\n"
+                  "\t\tfont1 = \"ffffff\";\n\t\tfont2 = \"000000\";\n"
+                  "\t\tbgImgTop = \"%s\";\n\t\tbgImgBot = \"%s\";\n\t};\n};\n", BENCH_IMG_TOP, BENCH_IMG_BOT);
+    fclose(file);
+    // written a while ago, so its mtime alone tells if the cache is fresh
+    benchMtime(time(NULL) - 60);
+
+    // every run starts from boot.cfg alone
+    remove(CONFIG_CACHE_PATH);
+    remove(CONFIG_JOURNAL_PATH);
+    return 0;
+}
+
+static void benchParse(int entries, u32 iterations) {
+    bench_s b;
+    benchStart(&b, "parse");
+    u32 i;
+    for (i = 0; i < iterations; i++) {
+        configExit();
+        u64 start = benchNow();
+        configParse();
+        benchAdd(&b, benchNow() - start);
+    }
+    benchReport(&b, "\"entries\": %d", entries);
+}
+
+static void benchCache(int entries, u32 iterations) {
+
+    bench_s write, load;
+    benchStart(&write, "cache_write");
+    benchStart(&load, "cache_load");
+    u32 i;
+    for (i = 0; i < iterations; i++) {
+        configExit();
+        configParse();
+        u64 start = benchNow();
+        configCacheWrite(BENCH_CFG_PATH);
+        benchAdd(&write, benchNow() - start);
+
+        configExit();
+        start = benchNow();
+        configCacheLoad(BENCH_CFG_PATH);
+        benchAdd(&load, benchNow() - start);
+    }
+    benchReport(&write, "\"entries\": %d", entries);
+    benchReport(&load, "\"entries\": %d", entries);
+
+    // without mtime the whole boot.cfg is hashed on every load
+    time_t mtime = time(NULL) - 60;
+    benchMtime(0);
+    configExit();
+    configParse();
+    configCacheWrite(BENCH_CFG_PATH);
+    benchStart(&load, "cache_load_crc");
+    for (i = 0; i < iterations; i++) {
+        configExit();
+        u64 start = benchNow();
+        configCacheLoad(BENCH_CFG_PATH);
+        benchAdd(&load, benchNow() - start);
+    }
+    benchReport(&load, "\"entries\": %d", entries);
+    benchMtime(mtime);
+    configCacheInvalidate();
+}
+
+// configInit as the boot sees it, without and with a fresh cache
+static void benchLoad(int entries, u32 iterations) {
+
+    bench_s cold, cached;
+    benchStart(&cold, "init_cold");
+    benchStart(&cached, "init_cached");
+    u32 i;
+    for (i = 0; i < iterations; i++) {
+        configExit();
+        configCacheInvalidate();
+        u64 start = benchNow();
+        configInit();
+        benchAdd(&cold, benchNow() - start);
+
+        configExit();
+        start = benchNow();
+        configInit();
+        benchAdd(&cached, benchNow() - start);
+    }
+    benchReport(&cold, "\"entries\": %d", entries);
+    benchReport(&cached, "\"entries\": %d", entries);
+}
+
+// changes pending in /boot.cfg.log applied over the cached profiles
+static void benchJournal(int entries, u32 iterations) {
+
+    // stay below CONFIG_JOURNAL_MAX so nothing is compacted into boot.cfg
+    int changes = CONFIG_JOURNAL_MAX - 1;
+    configExit();
+    configInit();
+    int i;
+    for (i = 0; i < changes; i++) {
+        if (i % 3 == 2) {
+            configRemoveEntry(0);
+        } else {
+            configAddEntry("Journaled", "/payloads/journaled.bin", 0x12000);
+        }
+    }
+
+    bench_s b;
+    benchStart(&b, "journal_replay");
+    u32 n;
+    for (n = 0; n < iterations; n++) {
+        configExit();
+        configCacheLoad(BENCH_CFG_PATH);
+        u64 start = benchNow();
+        configJournalReplay(BENCH_CFG_PATH);
+        benchAdd(&b, benchNow() - start);
+    }
+    benchReport(&b, "\"entries\": %d, \"changes\": %d", entries, changes);
+    remove(CONFIG_JOURNAL_PATH);
+}
+
+// settings and theme colors (setColor) of the boot_config group
+static void benchTheme(int entries, u32 iterations) {
+
+    config_t tree;
+    config_init(&tree);
+    if (!config_read_file(&tree, BENCH_CFG_PATH)) {
+        config_destroy(&tree);
+        return;
+    }
+    config_setting_t *group = config_lookup(&tree, "boot_config");
+    boot_config_s *cfg = calloc(1, sizeof(boot_config_s));
+
+    bench_s b;
+    benchStart(&b, "theme_resolve");
+    u32 i;
+    for (i = 0; cfg && group && i < iterations; i++) {
+        u64 start = benchNow();
+        configSchemaRead(cfg, group);
+        benchAdd(&b, benchNow() - start);
+    }
+    benchReport(&b, "\"entries\": %d", entries);
+
+    free(cfg);
+    config_destroy(&tree);
+}
+
+// configAddEntry + configRemoveEntry, journaled and compacted as on the device
+static void benchChurn(int entries, u32 iterations) {
+
+    configExit();
+    configInit();
+
+    bench_s add, rem;
+    benchStart(&add, "entry_add");
+    benchStart(&rem, "entry_remove");
+    u32 i;
+    for (i = 0; i < iterations; i++) {
+        u64 start = benchNow();
+        configAddEntry("Churn", "/payloads/churn.bin", 0);
+        benchAdd(&add, benchNow() - start);
+
+        start = benchNow();
+        configRemoveEntry(config->count - 1);
+        benchAdd(&rem, benchNow() - start);
+    }
+    benchReport(&add, "\"entries\": %d", entries);
+    benchReport(&rem, "\"entries\": %d", entries);
+}
+
+// the two background images of the theme, full screen rgb
+static void benchImages(u32 iterations) {
+
+    size_t topSize = 400 * 240 * 3, botSize = 320 * 240 * 3;
+    u8 *data = calloc(1, topSize);
+    if (!data || benchWriteFile(BENCH_IMG_TOP, data, topSize) != 0
+        || benchWriteFile(BENCH_IMG_BOT, data, botSize) != 0) {
+        free(data);
+        return;
+    }
+    free(data);
+
+    configExit();
+    configInit();
+
+    bench_s b;
+    benchStart(&b, "load_images");
+    u32 i;
+    for (i = 0; i < iterations; i++) {
+        u64 start = benchNow();
+        loadImages();
+        benchAdd(&b, benchNow() - start);
+
+        free(config->bgImgTopBuff);
+        free(config->bgImgBotBuff);
+        config->bgImgTopBuff = NULL;
+        config->bgImgBotBuff = NULL;
+    }
+    benchReport(&b, "\"bytes\": %lu", (unsigned long) (topSize + botSize));
+}
+
+int main(int argc, char **argv) {
+
+    u32 iterations = benchInit(argc, argv, 20);
+
+    benchBegin("config");
+    size_t i;
+    for (i = 0; i < sizeof(bench_entries) / sizeof(bench_entries[0]); i++) {
+        int entries = bench_entries[i];
+        if (benchConfig(entries) != 0) {
+            fprintf(stderr, "can't write %s\n", hostPath(BENCH_CFG_PATH));
+            return 1;
+        }
+        benchParse(entries, iterations);
+        benchCache(entries, iterations);
+        benchLoad(entries, iterations);
+        benchJournal(entries, iterations);
+        benchTheme(entries, iterations);
+        benchChurn(entries, iterations);
+    }
+    benchImages(iterations);
+    benchEnd();
+
+    configExit();
+    return 0;
+}
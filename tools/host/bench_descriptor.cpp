@@ -0,0 +1,165 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "descriptor.h"
+#include "bench.h"
+
+// 3dsx descriptors: parseDescriptor / loadDescriptor (streaming, in place) against
+// the tinyxml2 loader they replaced (descriptor_reference.cpp), on generated .xml files
+// usage: bench_descriptor [--iterations n] > descriptor.json
+
+void loadDescriptorReference(descriptor_s *d, char *path);
+
+void freeDescriptorReference(descriptor_s *d);
+
+// scanner.c is only linked for initMetadata
+extern "C" bool execIndexLookup(const char *path, executableMetadata_s *em) {
+    return false;
+}
+
+extern "C" void execIndexPut(const char *path, const executableMetadata_s *em) {
+}
+
+typedef struct {
+    const char *name;
+    int titles;
+    int services;
+    bool badPriority;   // missing and non-numeric priorities, the default applies
+} bench_fixture_s;
+
+// "over" is past DESCRIPTOR_*_MAX, only its first entries are kept
+static const bench_fixture_s bench_fixtures[] = {
+        {"typical",      2,  3,  false},
+        {"medium",       16, 16, false},
+        {"max",          DESCRIPTOR_TITLES_MAX,      DESCRIPTOR_SERVICES_MAX,      false},
+        {"over",         DESCRIPTOR_TITLES_MAX + 8,  DESCRIPTOR_SERVICES_MAX + 8,  false},
+        {"bad_priority", 2,  8,  true},
+};
+
+static const char *bench_services[] = {"soc:U", "csnd:SND", "qtm:s", "nfc:u", "http:C", "ir:USER", "cam:u", "mic:u"};
+
+static const char *bench_bad_priorities[] = {" priority=\"high\"", " priority=\"\"", "", " priority=\"-\"",
+                                             " priority=\"3x\"", " priority=\" 2\""};
+
+static int bench_failed = 0;
+
+static size_t benchXml(const bench_fixture_s *fixture, char *buf, size_t size) {
+
+    size_t len = (size_t) snprintf(buf, size, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                                              "<!-- generated by bench_descriptor -->\n"
+                                              "<targets selectable=\"true\">\n");
+    int i;
+    for (i = 0; i < fixture->titles && len < size; i++) {
+        len += (size_t) snprintf(buf + len, size - len, "\t<title mediatype=\"%d\">%016llx</title>\n",
+                                 i % 3, 0x0004000000030000ULL + (unsigned long long) i * 0x100);
+    }
+    len += (size_t) snprintf(buf + len, size - len, "</targets>\n<services autodetect=\"false\">\n");
+    for (i = 0; i < fixture->services && len < size; i++) {
+        if (fixture->badPriority) {
+            len += (size_t) snprintf(buf + len, size - len, "\t<request%s>%s</request>\n",
+                                     bench_bad_priorities[i % 6], bench_services[i % 8]);
+        } else {
+            len += (size_t) snprintf(buf + len, size - len, "\t<request priority=\"%d\">%s</request>\n",
+                                     1 + i % 4, bench_services[i % 8]);
+        }
+    }
+    len += (size_t) snprintf(buf + len, size - len, "</services>\n");
+    return len < size ? len : 0;
+}
+
+// the new loader keeps the first *_MAX entries of what the old one read
+static void benchCompare(const char *name, const descriptor_s *d, const descriptor_s *ref) {
+
+    u32 titles = ref->numTargetTitles < DESCRIPTOR_TITLES_MAX ? ref->numTargetTitles : DESCRIPTOR_TITLES_MAX;
+    u32 services = ref->numRequestedServices < DESCRIPTOR_SERVICES_MAX
+                   ? ref->numRequestedServices : DESCRIPTOR_SERVICES_MAX;
+    bool truncated = ref->numTargetTitles > DESCRIPTOR_TITLES_MAX
+                     || ref->numRequestedServices > DESCRIPTOR_SERVICES_MAX;
+
+    bool same = d->numTargetTitles == titles && d->numRequestedServices == services
+                && d->truncated == truncated
+                && d->selectTargetProcess == ref->selectTargetProcess
+                && d->autodetectServices == ref->autodetectServices;
+    u32 i;
+    for (i = 0; same && i < titles; i++) {
+        same = d->targetTitles[i].tid == ref->targetTitles[i].tid
+               && d->targetTitles[i].mediatype == ref->targetTitles[i].mediatype;
+    }
+    for (i = 0; same && i < services; i++) {
+        same = !strncmp(d->requestedServices[i].name, ref->requestedServices[i].name, 8)
+               && d->requestedServices[i].priority == ref->requestedServices[i].priority;
+    }
+    if (!same) {
+        fprintf(stderr, "%s: descriptor differs from the reference\n", name);
+        bench_failed = 1;
+    }
+}
+
+static void benchFixture(const bench_fixture_s *fixture, u32 iterations) {
+
+    static char xml[DESCRIPTOR_FILE_MAX];
+    size_t size = benchXml(fixture, xml, sizeof(xml));
+    char path[64];
+    snprintf(path, sizeof(path), "/bench_%s.xml", fixture->name);
+    if (!size || benchWriteFile(path, xml, size) != 0) {
+        fprintf(stderr, "can't write %s\n", hostPath(path));
+        bench_failed = 1;
+        return;
+    }
+    // tinyxml2 opens it with stdio, the stub only maps c files
+    char hostFile[1024];
+    snprintf(hostFile, sizeof(hostFile), "%s", hostPath(path));
+
+    bench_s parse, load, ref;
+    benchStart(&parse, "parse");
+    benchStart(&load, "load");
+    benchStart(&ref, "tinyxml2");
+    u32 i;
+    for (i = 0; i < iterations; i++) {
+        descriptor_s d, r;
+
+        initDescriptor(&d);
+        u64 start = benchNow();
+        parseDescriptor(&d, xml, size);
+        benchAdd(&parse, benchNow() - start);
+        freeDescriptor(&d);
+
+        initDescriptor(&d);
+        start = benchNow();
+        loadDescriptor(&d, path);
+        benchAdd(&load, benchNow() - start);
+
+        initDescriptor(&r);
+        start = benchNow();
+        loadDescriptorReference(&r, hostFile);
+        benchAdd(&ref, benchNow() - start);
+
+        if (i == 0) {
+            benchCompare(fixture->name, &d, &r);
+        }
+        freeDescriptor(&d);
+        freeDescriptorReference(&r);
+    }
+
+    benchReport(&parse, "\"file\": \"%s\", \"titles\": %d, \"services\": %d", fixture->name,
+                fixture->titles, fixture->services);
+    benchReport(&load, "\"file\": \"%s\", \"titles\": %d, \"services\": %d, \"scratch\": %lu", fixture->name,
+                fixture->titles, fixture->services, (unsigned long) descriptorHighWater());
+    benchReport(&ref, "\"file\": \"%s\", \"titles\": %d, \"services\": %d", fixture->name,
+                fixture->titles, fixture->services);
+}
+
+int main(int argc, char **argv) {
+
+    u32 iterations = benchInit(argc, argv, 200);
+
+    benchBegin("descriptor");
+    size_t i;
+    for (i = 0; i < sizeof(bench_fixtures) / sizeof(bench_fixtures[0]); i++) {
+        benchFixture(&bench_fixtures[i], iterations);
+    }
+    benchEnd();
+
+    return bench_failed;
+}
@@ -0,0 +1,209 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "payload.h"
+#include "bench.h"
+
+// the arm9 payload pipeline stages on file-backed stand-ins, and their output checked
+// usage: bench_payload [--iterations n] > payload.json
+
+#define BENCH_PAYLOAD_SIZE 0x10000      // LOAD_BIN_MAX_SIZE
+#define BENCH_PAYLOAD_OFFSET 0x12000    // like a ReiNand.dat entry
+#define BENCH_RAW_PATH "/bench_payload.dat"
+#define BENCH_ZLIB_PATH "/bench_payload.bin.gz"
+#define BENCH_BIG_PATH "/bench_big.bin.gz"
+#define BENCH_IPS_PATH "/bench_payload.ips"
+#define BENCH_IPS_RECORDS 64
+
+static u8 *bench_payload;
+static u8 *bench_patched;
+static u8 *bench_buf;
+static int bench_failed = 0;
+
+// arm code compresses about 2:1, words from a small alphabet do the same
+static void benchFill(u8 *buf, size_t size, u32 seed) {
+    static const u32 words[] = {0xe92d4010, 0xe8bd8010, 0xe3a00000, 0xe12fff1e,
+                                0xe59f0000, 0xe5901000, 0xeb000000, 0xe1a00004};
+    size_t i;
+    for (i = 0; i + 4 <= size; i += 4) {
+        seed = seed * 1103515245 + 12345;
+        u32 word = words[seed >> 29] | ((seed >> 8) & 0xff);
+        memcpy(buf + i, &word, 4);
+    }
+}
+
+static int benchZlib(const char *path, const u8 *data, size_t size) {
+    uLongf len = compressBound(size);
+    u8 *out = malloc(len);
+    int ret = out && compress2(out, &len, data, size, Z_BEST_COMPRESSION) == Z_OK
+              ? benchWriteFile(path, out, len) : -1;
+    free(out);
+    return ret;
+}
+
+static void benchIps24(u8 *p, u32 v) {
+    p[0] = (u8) (v >> 16);
+    p[1] = (u8) (v >> 8);
+    p[2] = (u8) v;
+}
+
+// BENCH_IPS_RECORDS records, every other one rle, applied to bench_patched as well
+static int benchIps() {
+
+    u8 *ips = malloc(5 + BENCH_IPS_RECORDS * (3 + 2 + 32) + 3);
+    if (!ips) {
+        return -1;
+    }
+    memcpy(bench_patched, bench_payload, BENCH_PAYLOAD_SIZE);
+    memcpy(ips, "PATCH", 5);
+    u8 *p = ips + 5;
+    int i;
+    for (i = 0; i < BENCH_IPS_RECORDS; i++) {
+        u32 offset = (u32) i * (BENCH_PAYLOAD_SIZE / BENCH_IPS_RECORDS);
+        benchIps24(p, offset);
+        p += 3;
+        if (i & 1) {
+            // rle: u16 0, u16 count, value
+            p[0] = 0, p[1] = 0, p[2] = 0, p[3] = 64, p[4] = (u8) i;
+            p += 5;
+            memset(bench_patched + offset, i, 64);
+        } else {
+            p[0] = 0, p[1] = 32;
+            p += 2;
+            memset(p, 0xa0 + i, 32);
+            memcpy(bench_patched + offset, p, 32);
+            p += 32;
+        }
+    }
+    memcpy(p, "EOF", 3);
+    p += 3;
+    int ret = benchWriteFile(BENCH_IPS_PATH, ips, (size_t) (p - ips));
+    free(ips);
+    return ret;
+}
+
+static int benchSetup() {
+
+    size_t size = BENCH_PAYLOAD_OFFSET + BENCH_PAYLOAD_SIZE;
+    u8 *raw = malloc(size);
+    u8 *big = malloc(4 * BENCH_PAYLOAD_SIZE);
+    bench_payload = malloc(BENCH_PAYLOAD_SIZE);
+    bench_patched = malloc(BENCH_PAYLOAD_SIZE);
+    bench_buf = malloc(BENCH_PAYLOAD_SIZE);
+    if (!raw || !big || !bench_payload || !bench_patched || !bench_buf) {
+        return -1;
+    }
+
+    benchFill(bench_payload, BENCH_PAYLOAD_SIZE, 1);
+    benchFill(raw, BENCH_PAYLOAD_OFFSET, 2);
+    memcpy(raw + BENCH_PAYLOAD_OFFSET, bench_payload, BENCH_PAYLOAD_SIZE);
+    benchFill(big, 4 * BENCH_PAYLOAD_SIZE, 3);
+
+    int ret = benchWriteFile(BENCH_RAW_PATH, raw, size) == 0
+              && benchZlib(BENCH_ZLIB_PATH, bench_payload, BENCH_PAYLOAD_SIZE) == 0
+              && benchZlib(BENCH_BIG_PATH, big, 4 * BENCH_PAYLOAD_SIZE) == 0
+              && benchIps() == 0 ? 0 : -1;
+    free(raw);
+    free(big);
+    return ret;
+}
+
+static void benchCheck(const char *name, long len, const u8 *expected) {
+    if (len != BENCH_PAYLOAD_SIZE || memcmp(bench_buf, expected, BENCH_PAYLOAD_SIZE) != 0) {
+        fprintf(stderr, "%s: wrong payload (%ld bytes)\n", name, len);
+        bench_failed = 1;
+    }
+}
+
+// what load_arm9_payload_offset did: stdio read of the whole payload
+static void benchStdio(u32 iterations) {
+    bench_s b;
+    benchStart(&b, "read_stdio");
+    u32 i;
+    for (i = 0; i < iterations; i++) {
+        u64 start = benchNow();
+        FILE *file = fopen(BENCH_RAW_PATH, "rb");
+        long len = -1;
+        if (file) {
+            fseek(file, BENCH_PAYLOAD_OFFSET, SEEK_SET);
+            len = (long) fread(bench_buf, 1, BENCH_PAYLOAD_SIZE, file);
+            fclose(file);
+        }
+        benchAdd(&b, benchNow() - start);
+        benchCheck(b.name, len, bench_payload);
+    }
+    benchReport(&b, "\"bytes\": %d", BENCH_PAYLOAD_SIZE);
+}
+
+static void benchStage(const char *name, const char *path, long offset, u32 flags, const char *patch,
+                       const u8 *expected, u32 iterations) {
+    bench_s b;
+    benchStart(&b, name);
+    u32 i;
+    for (i = 0; i < iterations; i++) {
+        u64 start = benchNow();
+        long len = payloadStage(path, offset, flags, patch, bench_buf, BENCH_PAYLOAD_SIZE);
+        benchAdd(&b, benchNow() - start);
+        benchCheck(name, len, expected);
+    }
+    benchReport(&b, "\"bytes\": %d", BENCH_PAYLOAD_SIZE);
+}
+
+// the patch stage alone, over an already staged payload
+static void benchPatch(u32 iterations) {
+    bench_s b;
+    benchStart(&b, "patch");
+    u32 i;
+    for (i = 0; i < iterations; i++) {
+        payload_staging_s staging;
+        payloadStagingInit(&staging, bench_buf, BENCH_PAYLOAD_SIZE);
+        memcpy(bench_buf, bench_payload, BENCH_PAYLOAD_SIZE);
+        staging.size = BENCH_PAYLOAD_SIZE;
+        u64 start = benchNow();
+        int ret = payloadPatch(&staging, BENCH_IPS_PATH);
+        benchAdd(&b, benchNow() - start);
+        benchCheck(b.name, ret == 0 ? (long) staging.size : -1, bench_patched);
+    }
+    benchReport(&b, "\"records\": %d", BENCH_IPS_RECORDS);
+}
+
+// a payload inflating past the arm9 limit is refused without inflating all of it
+static void benchOversize(u32 iterations) {
+    bench_s b;
+    benchStart(&b, "reject_oversize");
+    u32 i;
+    for (i = 0; i < iterations; i++) {
+        u64 start = benchNow();
+        long len = payloadStage(BENCH_BIG_PATH, 0, PAYLOAD_ZLIB, NULL, bench_buf, BENCH_PAYLOAD_SIZE);
+        benchAdd(&b, benchNow() - start);
+        if (len != PAYLOAD_TOO_LARGE) {
+            fprintf(stderr, "%s: oversize payload not rejected (%ld)\n", b.name, len);
+            bench_failed = 1;
+        }
+    }
+    benchReport(&b, "\"bytes\": %d", 4 * BENCH_PAYLOAD_SIZE);
+}
+
+int main(int argc, char **argv) {
+
+    u32 iterations = benchInit(argc, argv, 50);
+    if (benchSetup() != 0) {
+        fprintf(stderr, "can't write the payloads in %s\n", hostPath("/"));
+        return 1;
+    }
+
+    benchBegin("payload");
+    benchStdio(iterations);
+    benchStage("read", BENCH_RAW_PATH, BENCH_PAYLOAD_OFFSET, 0, NULL, bench_payload, iterations);
+    benchStage("inflate", BENCH_ZLIB_PATH, 0, PAYLOAD_ZLIB, NULL, bench_payload, iterations);
+    benchPatch(iterations);
+    benchStage("inflate_patch", BENCH_ZLIB_PATH, 0, PAYLOAD_ZLIB, BENCH_IPS_PATH, bench_patched, iterations);
+    benchOversize(iterations);
+    benchEnd();
+
+    free(bench_payload);
+    free(bench_patched);
+    free(bench_buf);
+    return bench_failed;
+}
@@ -0,0 +1,201 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scanner.h"
+#include "exec_index.h"
+#include "bench.h"
+
+// 3dsx service scan: scan3dsx (aho-corasick, aligned fs reads) against the
+// byte by byte matcher it replaced (scan_reference.c), on generated 3dsx files
+// and on any given sd paths (under $HOST_SD)
+// usage: bench_scan [--iterations n] [/3ds/app/app.3dsx ...] > scan.json
+
+#define BENCH_CODE_SIZE 0x40000
+#define BENCH_DATA_SIZE 0x8000
+
+extern const char *servicesThatMatter[];
+
+Result scanReference(char *path, char **patterns, int num_patterns, u32 *sectionSizes, bool *patternsFound);
+
+// scanMenuEntry's index isn't measured here
+bool execIndexLookup(const char *path, executableMetadata_s *em) {
+    return false;
+}
+
+void execIndexPut(const char *path, const executableMetadata_s *em) {
+}
+
+// where the service names go in rodata
+typedef enum {
+    BENCH_END,          // near the end, the whole rodata is read
+    BENCH_START,        // near the start, the scan can stop there
+    BENCH_SPLIT         // across SCAN_BLOCK_SIZE boundaries of the file, split between two reads
+} bench_place_e;
+
+typedef struct {
+    const char *name;
+    u32 rodataSize;
+    u32 services;       // BIT(i): servicesThatMatter[i] is in rodata
+    bench_place_e place;
+} bench_fixture_s;
+
+static const bench_fixture_s bench_fixtures[] = {
+        {"none_64k",  0x10000,  0,               BENCH_END},
+        {"none_1m",   0x100000, 0,               BENCH_END},
+        {"some_1m",   0x100000, BIT(0) | BIT(4), BENCH_END},
+        {"all_1m",    0x100000, 0x1f,            BENCH_START},
+        {"split_1m",  0x100000, 0x1f,            BENCH_SPLIT},
+        {"none_4m",   0x400000, 0,               BENCH_END},
+};
+
+static int bench_failed = 0;
+static u32 bench_seed = 0x12345678;
+
+static u32 benchRand() {
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return bench_seed >> 8;
+}
+
+// rodata of a c++ homebrew: strings, format strings, namespaces (lots of ':'),
+// and binary tables
+static void benchRodata(u8 *buf, u32 size) {
+    static const char *words[] = {"std::vector", "%s: %d\n", "error: ", "sdmc:/", "::operator",
+                                  "texture", "romfs:/", "http://", "soc", "nfc", "u:", "Result"};
+    u32 i = 0;
+    while (i < size) {
+        if (benchRand() % 4 == 0) {
+            const char *w = words[benchRand() % (sizeof(words) / sizeof(words[0]))];
+            size_t len = strlen(w) + 1;
+            if (i + len > size) {
+                break;
+            }
+            memcpy(buf + i, w, len);
+            i += (u32) len;
+        } else {
+            u32 n = 1 + benchRand() % 32;
+            while (n-- && i < size) {
+                buf[i++] = (u8) benchRand();
+            }
+        }
+    }
+    while (i < size) {
+        buf[i++] = 0;
+    }
+}
+
+static int benchFixture(const bench_fixture_s *fixture, const char *path) {
+
+    u32 headerSize = 0x2c, relocHdrSize = 8;
+    size_t size = headerSize + 3 * relocHdrSize + BENCH_CODE_SIZE + fixture->rodataSize + BENCH_DATA_SIZE;
+    u8 *file = calloc(1, size);
+    if (!file) {
+        return -1;
+    }
+
+    u32 hdr[] = {_3DSX_MAGIC, headerSize | relocHdrSize << 16, 0, 0,
+                 BENCH_CODE_SIZE, fixture->rodataSize, BENCH_DATA_SIZE, 0x1000};
+    memcpy(file, hdr, sizeof(hdr));
+    u8 *code = file + headerSize + 3 * relocHdrSize;
+    u32 i;
+    for (i = 0; i < BENCH_CODE_SIZE; i++) {
+        code[i] = (u8) benchRand();
+    }
+    u8 *rodata = code + BENCH_CODE_SIZE;
+    benchRodata(rodata, fixture->rodataSize);
+
+    // away from the edges of rodata, the old matcher reads it a bit off
+    u32 offset = (u32) (rodata - file);
+    for (i = 0; i < NUM_SERVICESTHATMATTER; i++) {
+        if (!(fixture->services & BIT(i))) {
+            continue;
+        }
+        u32 at;
+        switch (fixture->place) {
+            case BENCH_START:
+                at = 0x100 + i * 0x40;
+                break;
+            case BENCH_SPLIT:
+                // i + 1 bytes before the boundary of block i + 2
+                at = ((offset / SCAN_BLOCK_SIZE + i + 2) * SCAN_BLOCK_SIZE) - offset - (i + 1);
+                break;
+            default:
+                at = fixture->rodataSize - 0x100 - i * 0x40;
+                break;
+        }
+        memcpy(rodata + at, servicesThatMatter[i], strlen(servicesThatMatter[i]) + 1);
+    }
+
+    int ret = benchWriteFile(path, file, size);
+    free(file);
+    return ret;
+}
+
+static void benchScan(const char *name, const char *path, u32 iterations) {
+
+    bool found[NUM_SERVICESTHATMATTER], expected[NUM_SERVICESTHATMATTER];
+    u32 sizes[3];
+    bench_s ac, ref;
+    benchStart(&ac, "aho_corasick");
+    benchStart(&ref, "reference");
+    u32 i;
+    for (i = 0; i < iterations; i++) {
+        u64 start = benchNow();
+        Result ret = scan3dsx((char *) path, (char **) servicesThatMatter, NUM_SERVICESTHATMATTER, sizes, found);
+        benchAdd(&ac, benchNow() - start);
+
+        start = benchNow();
+        Result refRet = scanReference((char *) path, (char **) servicesThatMatter, NUM_SERVICESTHATMATTER,
+                                      sizes, expected);
+        benchAdd(&ref, benchNow() - start);
+
+        if (ret != 0 || refRet != 0) {
+            fprintf(stderr, "%s: can't scan %s\n", name, path);
+            bench_failed = 1;
+            break;
+        }
+        if (memcmp(found, expected, sizeof(found)) != 0) {
+            fprintf(stderr, "%s: services found differ from the reference\n", name);
+            bench_failed = 1;
+            break;
+        }
+    }
+
+    u32 services = 0;
+    for (i = 0; i < NUM_SERVICESTHATMATTER; i++) {
+        services += found[i];
+    }
+    benchReport(&ac, "\"file\": \"%s\", \"rodata\": %u, \"services\": %u, \"bytes_read\": %u",
+                name, sizes[1], services, scanStats()->bytes);
+    benchReport(&ref, "\"file\": \"%s\", \"rodata\": %u, \"services\": %u", name, sizes[1], services);
+}
+
+int main(int argc, char **argv) {
+
+    u32 iterations = benchInit(argc, argv, 10);
+
+    benchBegin("scan");
+    size_t i;
+    for (i = 0; i < sizeof(bench_fixtures) / sizeof(bench_fixtures[0]); i++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/bench_%s.3dsx", bench_fixtures[i].name);
+        if (benchFixture(&bench_fixtures[i], path) != 0) {
+            fprintf(stderr, "can't write %s\n", hostPath(path));
+            return 1;
+        }
+        benchScan(bench_fixtures[i].name, path, iterations);
+    }
+
+    // real executables, sd paths
+    int arg;
+    for (arg = 1; arg < argc; arg++) {
+        if (!strcmp(argv[arg], "--iterations")) {
+            arg++;
+            continue;
+        }
+        benchScan(argv[arg], argv[arg], iterations);
+    }
+    benchEnd();
+
+    return bench_failed;
+}
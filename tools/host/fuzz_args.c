@@ -0,0 +1,282 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "args.h"
+#include "bench.h"
+
+// argsAdd / argsAddList against a plain model: random argument lists,
+// buffer sizes around the fit, guard bytes around the buffer, then the argv build timed
+// usage: fuzz_args [--iterations n] [--seed n] > args.json
+
+#define FUZZ_CASES_PER_ITERATION 1000
+#define FUZZ_BUFFER_MAX 0x900       // bootApp uses 0x800
+#define FUZZ_GUARD 64
+#define FUZZ_FILL 0xa5
+#define FUZZ_OPS 24
+
+typedef struct {
+    u8 bytes[FUZZ_BUFFER_MAX];      // expected buffer content, argc left out
+    size_t size;
+    size_t used;
+    u32 argc;
+    bool overflow;
+} fuzz_model_s;
+
+static u32 fuzz_seed = 0x2545f491;
+static u32 fuzz_case = 0;
+static int fuzz_failed = 0;
+
+static u32 fuzzRand() {
+    fuzz_seed ^= fuzz_seed << 13;
+    fuzz_seed ^= fuzz_seed >> 17;
+    fuzz_seed ^= fuzz_seed << 5;
+    return fuzz_seed;
+}
+
+// spaces and quotes are plain bytes to the bootloader, they must come out as they went in
+static char fuzzChar(bool nul) {
+    static const char special[] = " \"'\\\t\n=-";
+    u32 r = fuzzRand() % 16;
+    if (nul && r == 0) {
+        return '\0';
+    }
+    if (r < 6) {
+        return special[fuzzRand() % (sizeof(special) - 1)];
+    }
+    if (r < 8) {
+        return (char) (0x80 + fuzzRand() % 0x80);
+    }
+    return (char) ('a' + fuzzRand() % 26);
+}
+
+// lengths around the space left, so exact fits and off by ones are frequent
+static size_t fuzzLength(const fuzz_model_s *m) {
+    size_t left = m->size > m->used ? m->size - m->used : 0;
+    switch (fuzzRand() % 6) {
+        case 0:
+            return 0;
+        case 1:
+            return left > 0 ? left - 1 : 0; // exact fit with the terminator
+        case 2:
+            return left;                    // one byte short
+        case 3:
+            return left + fuzzRand() % 4;
+        default:
+            return fuzzRand() % 48;
+    }
+}
+
+static bool modelAdd(fuzz_model_s *m, const char *str, size_t len) {
+    if (m->overflow || m->used + len + 1 > m->size) {
+        m->overflow = true;
+        return false;
+    }
+    memcpy(m->bytes + m->used, str, len);
+    m->bytes[m->used + len] = '\0';
+    m->used += len + 1;
+    m->argc++;
+    return true;
+}
+
+static bool fuzzFail(const char *what) {
+    fprintf(stderr, "case %u (seed 0x%08x): %s\n", fuzz_case, fuzz_seed, what);
+    fuzz_failed = 1;
+    return false;
+}
+
+static bool fuzzCheck(const args_s *args, const fuzz_model_s *m, const u8 *mem, size_t size) {
+
+    if (args->overflow != m->overflow) {
+        return fuzzFail("overflow flag");
+    }
+    if (args->buf[0] != m->argc) {
+        return fuzzFail("argc");
+    }
+    if (argsLength(args) != m->used) {
+        return fuzzFail("length");
+    }
+    const u8 *buf = mem + FUZZ_GUARD;
+    if (memcmp(buf + sizeof(u32), m->bytes + sizeof(u32), m->used - sizeof(u32)) != 0) {
+        return fuzzFail("arguments");
+    }
+    size_t i;
+    for (i = m->used; i < size; i++) {
+        if (buf[i] != FUZZ_FILL) {
+            return fuzzFail("write past the last argument");
+        }
+    }
+    for (i = 0; i < FUZZ_GUARD; i++) {
+        if (mem[i] != FUZZ_FILL || buf[size + i] != FUZZ_FILL) {
+            return fuzzFail("write outside the buffer");
+        }
+    }
+    return true;
+}
+
+static void fuzzOne(u8 *mem) {
+
+    // u32 aligned like argbuffer, at least room for argc
+    size_t size = sizeof(u32) + (fuzzRand() % (FUZZ_BUFFER_MAX / 4)) * 4;
+    if (fuzzRand() % 4 == 0) {
+        size = sizeof(u32) + (fuzzRand() % 4) * 4;
+    }
+    memset(mem, FUZZ_FILL, FUZZ_BUFFER_MAX + 2 * FUZZ_GUARD);
+    u32 *buf = (u32 *) (mem + FUZZ_GUARD);
+
+    args_s args;
+    argsInit(&args, buf, size);
+    fuzz_model_s m;
+    memset(m.bytes, 0, sizeof(u32));
+    m.size = size;
+    m.used = sizeof(u32);
+    m.argc = 0;
+    m.overflow = false;
+
+    int ops = 1 + (int) (fuzzRand() % FUZZ_OPS), op;
+    for (op = 0; op < ops; op++) {
+        char str[FUZZ_BUFFER_MAX + 8];
+        size_t len = fuzzLength(&m);
+        if (len > sizeof(str)) {
+            len = sizeof(str);
+        }
+        bool list = fuzzRand() % 2 == 0;
+        size_t i;
+        for (i = 0; i < len; i++) {
+            str[i] = fuzzChar(list);
+        }
+
+        bool ret;
+        bool expected = true;
+        if (list) {
+            // '\0' separated, empty arguments kept, the last one may be unterminated,
+            // an empty list adds nothing and succeeds even after an overflow
+            ret = argsAddList(&args, str, len);
+            const char *p = str, *end = str + len;
+            while (p < end && expected) {
+                const char *next = p;
+                while (next < end && *next != '\0') {
+                    next++;
+                }
+                expected = modelAdd(&m, p, (size_t) (next - p));
+                p = next + 1;
+            }
+        } else {
+            ret = argsAdd(&args, str, len);
+            expected = modelAdd(&m, str, len);
+        }
+
+        if (ret != expected) {
+            fuzzFail(list ? "argsAddList result" : "argsAdd result");
+            return;
+        }
+        if (!fuzzCheck(&args, &m, mem, size)) {
+            return;
+        }
+    }
+}
+
+// the edge cases named on their own, the random ones hit them too
+static void fuzzEdges(u8 *mem) {
+
+    u32 *buf = (u32 *) (mem + FUZZ_GUARD);
+    args_s args;
+
+    // nothing but argc: an empty argument no longer fits
+    argsInit(&args, buf, sizeof(u32));
+    if (argsAdd(&args, "", 0) || !args.overflow || args.buf[0] != 0) {
+        fuzzFail("empty argument in a full buffer");
+    }
+
+    // "abc\0" fills 8 bytes exactly, the next byte doesn't fit and stays dropped
+    argsInit(&args, buf, 8);
+    if (!argsAdd(&args, "abc", 3) || args.overflow || argsLength(&args) != 8) {
+        fuzzFail("exact fit");
+    }
+    if (argsAdd(&args, "", 0) || !args.overflow) {
+        fuzzFail("argument after an exact fit");
+    }
+    argsInit(&args, buf, 8);
+    if (argsAdd(&args, "abcd", 4) || !args.overflow || args.buf[0] != 0) {
+        fuzzFail("one byte short");
+    }
+
+    // once an argument was dropped the smaller ones after it are dropped as well
+    argsInit(&args, buf, 16);
+    if (argsAdd(&args, "0123456789abcdef", 16) || argsAdd(&args, "a", 1) || args.buf[0] != 0) {
+        fuzzFail("argument after an overflow");
+    }
+
+    // empty list, empty arguments, trailing terminator, unterminated last argument
+    argsInit(&args, buf, 64);
+    if (!argsAddList(&args, "", 0) || args.buf[0] != 0
+        || !argsAddList(&args, "\0\0", 2) || args.buf[0] != 2
+        || !argsAddList(&args, "-v\0", 3) || args.buf[0] != 3
+        || !argsAddList(&args, "a b\0\"c\"", 7) || args.buf[0] != 5
+        || argsLength(&args) != 4 + 2 + 3 + 4 + 4) {
+        fuzzFail("list edge cases");
+    }
+    if (memcmp((char *) (buf + 1) + 5, "a b\0\"c\"\0", 8) != 0) {
+        fuzzFail("quotes or spaces altered");
+    }
+}
+
+// bootApp's argv: the 3dsx path, an entry's args, a 3dslink command line
+static void benchArgv(u32 iterations) {
+
+    static u32 buf[0x200];
+    static const char entry[] = "-sd\0/cias/game.cia\0--verbose";
+    static const char netload[] = "3dslink\0-a\0\"quoted arg\"\0last";
+    const char *path = "sdmc:/3ds/boot/boot.3dsx";
+
+    bench_s b;
+    benchStart(&b, "build_argv");
+    u32 i;
+    for (i = 0; i < iterations * 1000; i++) {
+        args_s args;
+        u64 start = benchNow();
+        argsInit(&args, buf, sizeof(buf));
+        argsAdd(&args, path, strlen(path));
+        argsAddList(&args, entry, sizeof(entry) - 1);
+        argsAddList(&args, netload, sizeof(netload) - 1);
+        benchAdd(&b, benchNow() - start);
+        if (args.overflow || args.buf[0] != 8) {
+            fuzzFail("build_argv");
+            break;
+        }
+    }
+    benchReport(&b, "\"arguments\": %d", 8);
+}
+
+int main(int argc, char **argv) {
+
+    u32 iterations = benchInit(argc, argv, 100);
+    int i;
+    for (i = 1; i < argc - 1; i++) {
+        if (!strcmp(argv[i], "--seed")) {
+            fuzz_seed = (u32) strtoul(argv[i + 1], NULL, 0) | 1;
+        }
+    }
+
+    u8 *mem = malloc(FUZZ_BUFFER_MAX + 2 * FUZZ_GUARD);
+    if (!mem) {
+        return 1;
+    }
+    memset(mem, FUZZ_FILL, FUZZ_BUFFER_MAX + 2 * FUZZ_GUARD);
+    fuzzEdges(mem);
+
+    bench_s b;
+    benchBegin("args");
+    benchStart(&b, "fuzz");
+    for (fuzz_case = 0; fuzz_case < iterations * FUZZ_CASES_PER_ITERATION && !fuzz_failed; fuzz_case++) {
+        u64 start = benchNow();
+        fuzzOne(mem);
+        benchAdd(&b, benchNow() - start);
+    }
+    benchReport(&b, "\"cases\": %u", fuzz_case);
+    benchArgv(iterations);
+    benchEnd();
+
+    free(mem);
+    return fuzz_failed;
+}
@@ -0,0 +1,109 @@
+#ifndef _host_3ds_h_
+#define _host_3ds_h_
+
+// the part of ctrulib the host-built modules use, implemented in host.c
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HOST_LIBCONFIG
+#include <libconfig.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef volatile u32 vu32;
+typedef s32 Result;
+typedef u32 Handle;
+
+#define BIT(n) (1U<<(n))
+#define R_FAILED(res) ((res) < 0)
+#define R_SUCCEEDED(res) ((res) >= 0)
+#define U64_MAX UINT64_MAX
+
+#define SYSCLOCK_ARM11 268111856LL
+
+// ticks at SYSCLOCK_ARM11, from clock_gettime
+u64 svcGetSystemTick();
+
+// the host builds are single threaded
+typedef s32 LightLock;
+
+void LightLock_Init(LightLock *lock);
+
+void LightLock_Lock(LightLock *lock);
+
+void LightLock_Unlock(LightLock *lock);
+
+typedef enum {
+    PATH_INVALID = 0,
+    PATH_EMPTY = 1,
+    PATH_BINARY = 2,
+    PATH_ASCII = 3,
+    PATH_UTF16 = 4
+} FS_PathType;
+
+typedef struct {
+    FS_PathType type;
+    u32 size;
+    const void *data;
+} FS_Path;
+
+typedef struct {
+    u32 id;
+    FS_Path lowPath;
+    u64 handle;
+} FS_Archive;
+
+enum {
+    FS_OPEN_READ = BIT(0),
+    FS_OPEN_WRITE = BIT(1),
+    FS_OPEN_CREATE = BIT(2)
+};
+
+FS_Path fsMakePath(FS_PathType type, const void *path);
+
+// files of the sdmc archive (0x9) only
+Result FSUSER_OpenFileDirectly(Handle *out, FS_Archive archive, FS_Path path, u32 openFlags, u32 attributes);
+
+Result FSFILE_Read(Handle handle, u32 *bytesRead, u64 offset, void *buffer, u32 size);
+
+Result FSFILE_GetSize(Handle handle, u64 *size);
+
+Result FSFILE_Close(Handle handle);
+
+// sd paths ("/boot.cfg", "sdmc:/3ds/app.3dsx") are kept under $HOST_SD
+// ("sd" by default), relative paths are left alone
+const char *hostPath(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+// the system headers are already in, only the calls are redirected
+#if !defined(__cplusplus) && !defined(HOST_NATIVE_PATHS)
+#define fopen(path, mode) fopen(hostPath(path), mode)
+#define remove(path) remove(hostPath(path))
+#define rename(from, to) rename(hostPath(from), hostPath(to))
+#define stat(path, st) stat(hostPath(path), st)
+#ifdef HOST_LIBCONFIG
+#define config_read_file(config, path) config_read_file(config, hostPath(path))
+#define config_write_file(config, path) config_write_file(config, hostPath(path))
+#endif
+#endif
+
+#endif // _host_3ds_h_
@@ -0,0 +1,118 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "font.h"
+
+#define HOST_FILES 16
+#define HOST_PATHS 4
+
+// globals of the modules left out of the host build
+font_s fontDefault;
+font_s fontSelected;
+
+void debug(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+
+u64 svcGetSystemTick() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64) ts.tv_sec * SYSCLOCK_ARM11 + (u64) ts.tv_nsec * SYSCLOCK_ARM11 / 1000000000;
+}
+
+void LightLock_Init(LightLock *lock) {
+    *lock = 0;
+}
+
+void LightLock_Lock(LightLock *lock) {
+    *lock = 1;
+}
+
+void LightLock_Unlock(LightLock *lock) {
+    *lock = 0;
+}
+
+const char *hostPath(const char *path) {
+
+    // a few calls can share an expression, rename(from, to)
+    static char paths[HOST_PATHS][1024];
+    static int next = 0;
+
+    if (!strncmp(path, "sdmc:", 5)) {
+        path += 5;
+    }
+    if (path[0] != '/') {
+        return path;
+    }
+
+    const char *root = getenv("HOST_SD");
+    char *out = paths[next];
+    next = (next + 1) % HOST_PATHS;
+    snprintf(out, sizeof(paths[0]), "%s%s", root && *root ? root : "sd", path);
+    return out;
+}
+
+static FILE *host_files[HOST_FILES];
+
+FS_Path fsMakePath(FS_PathType type, const void *path) {
+    FS_Path p = {type, type == PATH_ASCII ? (u32) strlen((const char *) path) + 1 : 0, path};
+    return p;
+}
+
+Result FSUSER_OpenFileDirectly(Handle *out, FS_Archive archive, FS_Path path, u32 openFlags, u32 attributes) {
+
+    if (archive.id != 0x00000009 || path.type != PATH_ASCII || openFlags != FS_OPEN_READ) {
+        return -1;
+    }
+
+    int i;
+    for (i = 1; i < HOST_FILES; i++) {
+        if (!host_files[i]) {
+            host_files[i] = fopen((const char *) path.data, "rb");
+            if (!host_files[i]) {
+                return -1;
+            }
+            *out = (Handle) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static FILE *hostFile(Handle handle) {
+    return handle > 0 && handle < HOST_FILES ? host_files[handle] : NULL;
+}
+
+Result FSFILE_Read(Handle handle, u32 *bytesRead, u64 offset, void *buffer, u32 size) {
+    FILE *file = hostFile(handle);
+    if (!file || fseeko(file, (off_t) offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    *bytesRead = (u32) fread(buffer, 1, size, file);
+    return ferror(file) ? -1 : 0;
+}
+
+Result FSFILE_GetSize(Handle handle, u64 *size) {
+    FILE *file = hostFile(handle);
+    if (!file || fseeko(file, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    *size = (u64) ftello(file);
+    return 0;
+}
+
+Result FSFILE_Close(Handle handle) {
+    FILE *file = hostFile(handle);
+    if (!file) {
+        return -1;
+    }
+    fclose(file);
+    host_files[handle] = NULL;
+    return 0;
+}
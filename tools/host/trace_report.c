@@ -0,0 +1,226 @@
+#include <3ds.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+// per phase latency histograms of a /boot.trace log
+// usage: trace_report [--record] [path], path defaults to $HOST_SD/boot.trace
+//  --record: first append a simulated boot through the trace api
+
+#define REPORT_SERVICES 16
+#define REPORT_KEYS (TRACE_SCAN + 1 + REPORT_SERVICES)
+#define REPORT_SAMPLES (TRACE_BOOTS * TRACE_EVENTS)
+#define REPORT_BUCKETS 18   // log2 buckets from 64us, the last one open
+
+static const char *report_phases[] = {
+        "app_init", "config", "keys", "ready_hid", "ready_apt", "ready_display", "theme",
+        "menu", "netloader", "payload", "descriptor", "handover", "service", "scan"
+};
+
+// service.c service_table order
+static const char *report_services[] = {
+        "srv", "apt", "fs", "sdmc", "sd archive", "hid", "ac", "ptmu", "am"
+};
+
+typedef struct {
+    u32 count;
+    u32 samples[REPORT_SAMPLES];
+    u32 argMax;
+} report_key_s;
+
+static report_key_s report_keys[REPORT_KEYS];
+
+// services come up on their own thread, so their samples are
+// the time since traceStart, the other phases the time since the previous mark
+static int reportKey(const trace_event_s *event) {
+    if (event->phase == TRACE_SERVICE) {
+        return event->arg < REPORT_SERVICES ? TRACE_SCAN + 1 + event->arg : -1;
+    }
+    return event->phase <= TRACE_SCAN ? event->phase : -1;
+}
+
+static void reportName(int key, char *name, size_t size) {
+    if (key <= TRACE_SCAN) {
+        snprintf(name, size, "%s", report_phases[key]);
+    } else if (key - TRACE_SCAN - 1 < (int) (sizeof(report_services) / sizeof(report_services[0]))) {
+        snprintf(name, size, "service %s", report_services[key - TRACE_SCAN - 1]);
+    } else {
+        snprintf(name, size, "service %i", key - TRACE_SCAN - 1);
+    }
+}
+
+static void reportBoot(const trace_boot_s *boot) {
+
+    u32 prev = 0;
+    u32 i;
+    for (i = 0; i < boot->count && i < TRACE_EVENTS; i++) {
+        const trace_event_s *event = &boot->events[i];
+        int key = reportKey(event);
+        if (key < 0) {
+            continue;
+        }
+        report_key_s *k = &report_keys[key];
+        if (event->phase == TRACE_SERVICE) {
+            k->samples[k->count++] = event->us;
+        } else {
+            k->samples[k->count++] = event->us >= prev ? event->us - prev : 0;
+            prev = event->us;
+        }
+        if (event->arg > k->argMax) {
+            k->argMax = event->arg;
+        }
+    }
+}
+
+static int reportCompare(const void *a, const void *b) {
+    u32 x = *(const u32 *) a, y = *(const u32 *) b;
+    return x < y ? -1 : x > y;
+}
+
+static int reportBucket(u32 us) {
+    int bucket = 0;
+    while (bucket < REPORT_BUCKETS - 1 && us >= (64u << bucket)) {
+        bucket++;
+    }
+    return bucket;
+}
+
+static void reportPrint(u32 boots) {
+
+    printf("%u boots\n", boots);
+    printf("%-20s %6s %10s %10s %10s %6s\n", "phase", "count", "min_us", "median_us", "max_us", "arg");
+
+    int key;
+    for (key = 0; key < REPORT_KEYS; key++) {
+        report_key_s *k = &report_keys[key];
+        if (k->count == 0) {
+            continue;
+        }
+        qsort(k->samples, k->count, sizeof(u32), reportCompare);
+
+        char name[32];
+        reportName(key, name, sizeof(name));
+        printf("%-20s %6u %10u %10u %10u %6u\n", name, k->count,
+               k->samples[0], k->samples[k->count / 2], k->samples[k->count - 1], k->argMax);
+
+        u32 buckets[REPORT_BUCKETS] = {0};
+        u32 i;
+        for (i = 0; i < k->count; i++) {
+            buckets[reportBucket(k->samples[i])]++;
+        }
+        int b;
+        for (b = 0; b < REPORT_BUCKETS; b++) {
+            if (buckets[b] == 0) {
+                continue;
+            }
+            char range[32];
+            if (b == 0) {
+                snprintf(range, sizeof(range), "< %u", 64u);
+            } else if (b == REPORT_BUCKETS - 1) {
+                snprintf(range, sizeof(range), ">= %u", 64u << (b - 1));
+            } else {
+                snprintf(range, sizeof(range), "%u - %u", 64u << (b - 1), 64u << b);
+            }
+            printf("    %-20s %5u ", range, buckets[b]);
+            for (i = 0; i < buckets[b] * 40 / k->count; i++) {
+                putchar('#');
+            }
+            putchar('\n');
+        }
+    }
+}
+
+static int reportRead(const char *path) {
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "can't open %s\n", path);
+        return -1;
+    }
+
+    trace_header_s hdr;
+    if (fread(&hdr, 1, sizeof(trace_header_s), file) != sizeof(trace_header_s)
+        || hdr.magic != TRACE_MAGIC || hdr.version != TRACE_VERSION || hdr.next >= TRACE_BOOTS) {
+        fprintf(stderr, "%s: not a version %i boot trace\n", path, TRACE_VERSION);
+        fclose(file);
+        return -1;
+    }
+
+    // oldest first: the ring starts at next once it wrapped
+    u32 boots = hdr.boots < TRACE_BOOTS ? hdr.boots : TRACE_BOOTS;
+    u32 first = hdr.boots < TRACE_BOOTS ? 0 : hdr.next;
+    u32 i;
+    for (i = 0; i < boots; i++) {
+        trace_boot_s boot;
+        long pos = (long) (sizeof(trace_header_s) + ((first + i) % TRACE_BOOTS) * sizeof(trace_boot_s));
+        if (fseek(file, pos, SEEK_SET) != 0 || fread(&boot, 1, sizeof(trace_boot_s), file) != sizeof(trace_boot_s)) {
+            fprintf(stderr, "%s: truncated at boot %u\n", path, i);
+            fclose(file);
+            return -1;
+        }
+        reportBoot(&boot);
+    }
+    fclose(file);
+
+    if (boots == 0) {
+        fprintf(stderr, "%s: no boots recorded\n", path);
+        return -1;
+    }
+    reportPrint(boots);
+    return 0;
+}
+
+static void recordSleep(u32 us) {
+    struct timespec ts = {0, (long) us * 1000};
+    nanosleep(&ts, NULL);
+}
+
+// a boot in main.c order, services marked as the worker would
+static void recordBoot() {
+
+    traceStart();
+    traceMarkArg(TRACE_SERVICE, 0);
+    recordSleep(2000);
+    traceMark(TRACE_APP_INIT);
+    traceMarkArg(TRACE_SERVICE, 3);
+    recordSleep(4000);
+    traceMark(TRACE_CONFIG);
+    recordSleep(100);
+    traceMark(TRACE_KEYS);
+    traceMarkArg(TRACE_SERVICE, 5);
+    traceMark(TRACE_READY_HID);
+    recordSleep(1000);
+    traceMark(TRACE_READY_APT);
+    recordSleep(16000);
+    traceMark(TRACE_READY_DISPLAY);
+    recordSleep(3000);
+    traceMark(TRACE_THEME);
+    recordSleep(8000);
+    traceMark(TRACE_PAYLOAD);
+
+    traceEnable(true);
+    traceEnd();
+}
+
+int main(int argc, char **argv) {
+
+    const char *path = NULL;
+    bool record = false;
+    int i;
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--record")) {
+            record = true;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (record) {
+        // traceEnd writes TRACE_PATH under the host sd
+        mkdir(hostPath("/"), 0755);
+        recordBoot();
+    }
+    return reportRead(path ? path : hostPath(TRACE_PATH)) == 0 ? 0 : 1;
+}